@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "config.h"
+#include "console.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "pico/stdlib.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include <cstdio>
+#include <string.h>
+
+static uint64_t windowStartUs = 0;
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static void resetWindow() {
+  // Any write clears the XIP cache counters
+  xip_ctrl_hw->ctr_hit = 0;
+  xip_ctrl_hw->ctr_acc = 0;
+  scheduler_clearPeaks();
+  telemetry.renderMaxUs = 0;
+  windowStartUs = time_us_64();
+}
+
+static void report() {
+  // Read accesses first so hits can never exceed them
+  uint32_t acc = xip_ctrl_hw->ctr_acc;
+  uint32_t hit = xip_ctrl_hw->ctr_hit;
+  if (hit > acc)
+    hit = acc;
+  uint32_t permyriad = acc ? (uint32_t)((uint64_t)hit * 10000 / acc) : 10000;
+  uint32_t ms = (uint32_t)((time_us_64() - windowStartUs) / 1000);
+
+  printf("Bench: hot path in %s, window %lu ms\n",
+         HOT_PATH_IN_RAM ? "SRAM" : "flash", (unsigned long)ms);
+  printf("XIP: %lu accesses, %lu misses (%lu.%02lu%% hit)\n",
+         (unsigned long)acc, (unsigned long)(acc - hit),
+         (unsigned long)(permyriad / 100), (unsigned long)(permyriad % 100));
+  printf("Render max %lu us\n", (unsigned long)telemetry.renderMaxUs);
+  scheduler_printStats();
+}
+
+static void benchCommand(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+    resetWindow();
+    printf("Bench: counters reset\n");
+  } else {
+    report();
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void bench_init() {
+  console_addCommand("bench", benchCommand,
+                     "XIP cache and worst-case timings | reset");
+  resetWindow();
+}
@@ -0,0 +1,13 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Hot path benchmark.
+//
+// 'bench' on the console reports XIP cache hits and misses and the worst
+// task run times since 'bench reset'. Run the same MIDI traffic with
+// HOT_PATH_IN_RAM on and off to compare.
+
+// Register the console command and start the first window
+void bench_init();
+
+#endif // BENCH_H
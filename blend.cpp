@@ -0,0 +1,227 @@
+#include "blend.h"
+#include "config.h"
+#include "hotpath.h"
+
+#if defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#define BLEND_SIMD 1
+#else
+#define BLEND_SIMD 0
+#endif
+
+// ============================================================================
+// Per-Pixel Kernels
+// ============================================================================
+
+// Lanes 0 and 2 / lanes 1 and 3, each widened to a 16-bit field so a single
+// 32-bit multiply scales two lanes at once without carries between them
+static const uint32_t EVEN_LANES = 0x00FF00FF;
+static const uint32_t ODD_LANES = 0xFF00FF00;
+
+static inline uint32_t evenLanes(uint32_t px) {
+#if BLEND_SIMD
+  return __uxtb16(px);
+#else
+  return px & EVEN_LANES;
+#endif
+}
+
+static inline uint32_t oddLanes(uint32_t px) {
+#if BLEND_SIMD
+  return __uxtb16(__ror(px, 8));
+#else
+  return (px >> 8) & EVEN_LANES;
+#endif
+}
+
+uint32_t blend_scalePixel(uint32_t px, uint32_t level) {
+  // 255 * 256 fits in a 16-bit field, so level may be 0..256
+  uint32_t even = ((evenLanes(px) * level) >> 8) & EVEN_LANES;
+  uint32_t odd = (oddLanes(px) * level) & ODD_LANES;
+  return even | odd;
+}
+
+uint32_t blend_addSatPixel(uint32_t a, uint32_t b) {
+#if BLEND_SIMD
+  return __uqadd8(a, b);
+#else
+  // Add the low 7 bits of each lane (cannot carry across lanes), fix up bit
+  // 7, then saturate lanes that carried out
+  uint32_t low = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+  uint32_t sum = low ^ ((a ^ b) & 0x80808080);
+  uint32_t carry = ((a & b) | ((a ^ b) & ~sum)) & 0x80808080;
+  carry >>= 7;
+  return sum | ((carry << 8) - carry);
+#endif
+}
+
+static inline uint32_t maxPixel(uint32_t a, uint32_t b) {
+#if BLEND_SIMD
+  // USUB8 sets a GE flag per lane where a >= b; SEL picks lanes by those flags
+  (void)__usub8(a, b);
+  return __sel(a, b);
+#else
+  // Subtract a - b per lane with bit 7 held out so borrows stay in their
+  // lane, fix up bit 7, then widen each lane's borrow (a < b) into a mask
+  uint32_t diff = ((a | 0x80808080) - (b & 0x7F7F7F7F)) ^
+                  ((a ^ ~b) & 0x80808080);
+  uint32_t borrow = ((~a & b) | (~(a ^ b) & diff)) & 0x80808080;
+  borrow >>= 7;
+  uint32_t useB = (borrow << 8) - borrow;
+  return (a & ~useB) | (b & useB);
+#endif
+}
+
+static inline uint32_t mixPixel(uint32_t d, uint32_t s, uint32_t alpha) {
+  uint32_t inv = 256 - alpha;
+  uint32_t even =
+      ((evenLanes(s) * alpha + evenLanes(d) * inv) >> 8) & EVEN_LANES;
+  uint32_t odd = (oddLanes(s) * alpha + oddLanes(d) * inv) & ODD_LANES;
+  return even | odd;
+}
+
+// ============================================================================
+// Buffer Kernels
+// ============================================================================
+
+void HOT_FUNC(blend_fill)(uint32_t *dst, int n, uint32_t px) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = px;
+  }
+}
+
+void HOT_FUNC(blend_scale)(uint32_t *dst, int n, uint32_t level) {
+  if (level >= 256)
+    return;
+  if (level == 0) {
+    blend_fill(dst, n, 0);
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    dst[i] = blend_scalePixel(dst[i], level);
+  }
+}
+
+void HOT_FUNC(blend_addSat)(uint32_t *dst, const uint32_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = blend_addSatPixel(dst[i], src[i]);
+  }
+}
+
+void HOT_FUNC(blend_max)(uint32_t *dst, const uint32_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = maxPixel(dst[i], src[i]);
+  }
+}
+
+void HOT_FUNC(blend_mix)(uint32_t *dst, const uint32_t *src, int n, uint32_t alpha) {
+  if (alpha > 256)
+    alpha = 256;
+  for (int i = 0; i < n; i++) {
+    dst[i] = mixPixel(dst[i], src[i], alpha);
+  }
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+#if ENABLE_BLEND_BENCH
+#include "pico/stdlib.h"
+#include <cstdio>
+
+static uint32_t benchDst[LED_COUNT];
+static uint32_t benchSrc[LED_COUNT];
+
+// Reference: one lane at a time, the way leds_setPixel() scales colors
+static void scalarScale(uint32_t *dst, int n, uint32_t level) {
+  for (int i = 0; i < n; i++) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      out |= ((((dst[i] >> shift) & 0xFF) * level) >> 8) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+static void scalarAddSat(uint32_t *dst, const uint32_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      uint32_t v = ((dst[i] >> shift) & 0xFF) + ((src[i] >> shift) & 0xFF);
+      out |= (v > 255 ? 255 : v) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+static void scalarMix(uint32_t *dst, const uint32_t *src, int n,
+                      uint32_t alpha) {
+  for (int i = 0; i < n; i++) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      uint32_t d = (dst[i] >> shift) & 0xFF;
+      uint32_t s = (src[i] >> shift) & 0xFF;
+      out |= ((s * alpha + d * (256 - alpha)) >> 8) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+static void scalarMax(uint32_t *dst, const uint32_t *src, int n) {
+  for (int i = 0; i < n; i++) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      uint32_t d = (dst[i] >> shift) & 0xFF;
+      uint32_t s = (src[i] >> shift) & 0xFF;
+      out |= (d > s ? d : s) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+static void benchFill() {
+  uint32_t seed = 0x12345678;
+  for (int i = 0; i < LED_COUNT; i++) {
+    seed = seed * 1664525 + 1013904223;
+    benchDst[i] = seed;
+    seed = seed * 1664525 + 1013904223;
+    benchSrc[i] = seed;
+  }
+}
+
+#define BENCH(label, simd_call, scalar_call)                                   \
+  do {                                                                         \
+    benchFill();                                                               \
+    uint32_t t0 = time_us_32();                                                \
+    for (int r = 0; r < BENCH_REPS; r++) {                                     \
+      simd_call;                                                               \
+    }                                                                          \
+    uint32_t t1 = time_us_32();                                                \
+    benchFill();                                                               \
+    for (int r = 0; r < BENCH_REPS; r++) {                                     \
+      scalar_call;                                                             \
+    }                                                                          \
+    uint32_t t2 = time_us_32();                                                \
+    printf("  %-8s %6lu us  scalar %6lu us\n", label,                         \
+           (unsigned long)((t1 - t0) / BENCH_REPS),                            \
+           (unsigned long)((t2 - t1) / BENCH_REPS));                           \
+  } while (0)
+
+void blend_bench() {
+  const int BENCH_REPS = 16;
+  printf("Blend kernels, %d px (%s):\n", LED_COUNT,
+         BLEND_SIMD ? "DSP SIMD" : "portable SWAR");
+  BENCH("scale", blend_scale(benchDst, LED_COUNT, 200),
+        scalarScale(benchDst, LED_COUNT, 200));
+  BENCH("addSat", blend_addSat(benchDst, benchSrc, LED_COUNT),
+        scalarAddSat(benchDst, benchSrc, LED_COUNT));
+  BENCH("max", blend_max(benchDst, benchSrc, LED_COUNT),
+        scalarMax(benchDst, benchSrc, LED_COUNT));
+  BENCH("mix", blend_mix(benchDst, benchSrc, LED_COUNT, 96),
+        scalarMix(benchDst, benchSrc, LED_COUNT, 96));
+}
+
+#else
+void blend_bench() {}
+#endif
@@ -0,0 +1,37 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+
+// Pixel compositing kernels.
+//
+// Pixels are packed 32-bit words of four independent 8-bit lanes, so the
+// kernels work on any byte order (including the GRB wire format held in the
+// LED framebuffer). On Cortex-M33 they use the DSP extension's SIMD
+// instructions; elsewhere a portable SWAR fallback produces identical results.
+
+// dst[i] = px
+void blend_fill(uint32_t *dst, int n, uint32_t px);
+
+// dst[i] = dst[i] * level / 256, per lane
+void blend_scale(uint32_t *dst, int n, uint32_t level);
+
+// dst[i] = min(dst[i] + src[i], 255), per lane (additive glow)
+void blend_addSat(uint32_t *dst, const uint32_t *src, int n);
+
+// dst[i] = max(dst[i], src[i]), per lane (lighten)
+void blend_max(uint32_t *dst, const uint32_t *src, int n);
+
+// dst[i] = (src[i] * alpha + dst[i] * (256 - alpha)) / 256, per lane
+// (crossfade, alpha 0..256)
+void blend_mix(uint32_t *dst, const uint32_t *src, int n, uint32_t alpha);
+
+// Single-pixel forms for per-pixel effects
+uint32_t blend_scalePixel(uint32_t px, uint32_t level);
+uint32_t blend_addSatPixel(uint32_t a, uint32_t b);
+
+// Time each kernel against a plain per-lane scalar loop over LED_COUNT
+// pixels and print the results (ENABLE_BLEND_BENCH builds only)
+void blend_bench();
+
+#endif // BLEND_H
@@ -0,0 +1,258 @@
+#include "bsp.h"
+#include "hotpath.h"
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static Rect &leafRect(const BspTree *t, int item) {
+  return *(Rect *)(t->leafRects + item * t->leafStride);
+}
+
+static Rect nodeArea(const BspNode &n) { return Rect{n.x, n.y, n.w, n.h}; }
+
+static int leafArea(const BspTree *t, int item) {
+  const Rect &r = leafRect(t, item);
+  return r.w * r.h;
+}
+
+// Larger area wins, then the lower item number
+static bool HOT_FUNC(largerLeaf)(const BspTree *t, int a, int b) {
+  int aa = leafArea(t, a);
+  int ba = leafArea(t, b);
+  return aa > ba || (aa == ba && a < b);
+}
+
+static int refLargest(const BspTree *t, uint8_t ref) {
+  return (ref & BSP_LEAF) ? ref & ~BSP_LEAF : t->nodes[ref].largest;
+}
+
+static int refLeaves(const BspTree *t, uint8_t ref) {
+  return (ref & BSP_LEAF) ? 1 : t->nodes[ref].leaves;
+}
+
+static uint8_t refParent(const BspTree *t, uint8_t ref) {
+  return (ref & BSP_LEAF) ? t->leafParent[ref & ~BSP_LEAF]
+                          : t->nodes[ref].parent;
+}
+
+// Recompute a node's summary from its children
+static void HOT_FUNC(summarize)(BspTree *t, uint8_t node) {
+  BspNode &n = t->nodes[node];
+  int a = refLargest(t, n.child[0]);
+  int b = refLargest(t, n.child[1]);
+  n.largest = (uint8_t)(largerLeaf(t, a, b) ? a : b);
+  n.leaves = (uint8_t)(refLeaves(t, n.child[0]) + refLeaves(t, n.child[1]));
+}
+
+// Refresh the summaries from node up to the root
+static void HOT_FUNC(summarizePath)(BspTree *t, uint8_t node) {
+  while (node != BSP_NONE) {
+    summarize(t, node);
+    node = t->nodes[node].parent;
+  }
+}
+
+// Divide an area across its longer side in the ratio w0 : w1; the first
+// part gets the odd unit
+static void HOT_FUNC(splitArea)(Rect a, int w0, int w1, Rect *first,
+                                Rect *second) {
+  if (a.w >= a.h) {
+    int s = a.w - a.w * w1 / (w0 + w1);
+    *first = {a.x, a.y, s, a.h};
+    *second = {a.x + s, a.y, a.w - s, a.h};
+  } else {
+    int s = a.h - a.h * w1 / (w0 + w1);
+    *first = {a.x, a.y, a.w, s};
+    *second = {a.x, a.y + s, a.w, a.h - s};
+  }
+}
+
+// Lay out the subtree at ref inside area. Leaf counts must be current.
+static void HOT_FUNC(place)(BspTree *t, uint8_t ref, Rect area) {
+  if (ref & BSP_LEAF) {
+    leafRect(t, ref & ~BSP_LEAF) = area;
+    return;
+  }
+  BspNode &n = t->nodes[ref];
+  n.x = (bsp_coord_t)area.x;
+  n.y = (bsp_coord_t)area.y;
+  n.w = (bsp_coord_t)area.w;
+  n.h = (bsp_coord_t)area.h;
+
+  // A group shares its area out by item count; above that, halves
+  int w0 = 1, w1 = 1;
+  if (n.leaves <= BSP_GROUP_LEAVES) {
+    w0 = refLeaves(t, n.child[0]);
+    w1 = refLeaves(t, n.child[1]);
+  }
+  Rect a, b;
+  splitArea(area, w0, w1, &a, &b);
+  place(t, n.child[0], a);
+  place(t, n.child[1], b);
+  summarize(t, ref);
+}
+
+static void setParent(BspTree *t, uint8_t ref, uint8_t parent) {
+  if (ref & BSP_LEAF)
+    t->leafParent[ref & ~BSP_LEAF] = parent;
+  else
+    t->nodes[ref].parent = parent;
+}
+
+// Put 'to' where 'from' hangs in the tree
+static void HOT_FUNC(replaceChild)(BspTree *t, uint8_t parent, uint8_t from,
+                                   uint8_t to) {
+  if (parent == BSP_NONE) {
+    t->root = to;
+  } else {
+    BspNode &p = t->nodes[parent];
+    p.child[p.child[0] == from ? 0 : 1] = to;
+  }
+  setParent(t, to, parent);
+}
+
+// Add delta to the item counts from node up to the root. Returns the
+// highest node whose split changes (one that is, or was until now, a
+// group), or BSP_NONE.
+static uint8_t HOT_FUNC(countPath)(BspTree *t, uint8_t node, int delta) {
+  uint8_t top = BSP_NONE;
+  for (; node != BSP_NONE; node = t->nodes[node].parent) {
+    BspNode &n = t->nodes[node];
+    int before = n.leaves;
+    n.leaves = (uint8_t)(before + delta);
+    if ((delta > 0 ? before : n.leaves) <= BSP_GROUP_LEAVES)
+      top = node;
+  }
+  return top;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void bsp_init(BspTree *t, BspNode *nodes, uint8_t *leafParent, int capacity,
+              Rect *leafRects, size_t leafStride) {
+  t->nodes = nodes;
+  t->leafParent = leafParent;
+  t->capacity = (uint8_t)capacity;
+  t->leafRects = (uint8_t *)leafRects;
+  t->leafStride = leafStride;
+  bsp_clear(t, Rect{0, 0, 0, 0});
+}
+
+void bsp_clear(BspTree *t, Rect area) {
+  t->area = area;
+  t->root = BSP_NONE;
+  for (int i = 0; i < t->capacity; i++) {
+    t->leafParent[i] = BSP_ABSENT;
+  }
+  // Free list through the parent links
+  t->freeHead = BSP_NONE;
+  for (int i = t->capacity - 2; i >= 0; i--) {
+    t->nodes[i].parent = t->freeHead;
+    t->freeHead = (uint8_t)i;
+  }
+}
+
+bool HOT_FUNC(bsp_insert)(BspTree *t, int item, Rect *damage) {
+  if (item < 0 || item >= t->capacity || bsp_contains(t, item))
+    return false;
+
+  uint8_t leaf = BSP_LEAF | item;
+  if (t->root == BSP_NONE) {
+    t->root = leaf;
+    t->leafParent[item] = BSP_NONE;
+    leafRect(t, item) = t->area;
+    *damage = t->area;
+    return true;
+  }
+
+  // The largest leaf's group takes the item, on its emptier side, so a
+  // group that outgrows BSP_GROUP_LEAVES has two even halves
+  uint8_t at = BSP_LEAF | refLargest(t, t->root);
+  for (uint8_t up = refParent(t, at);
+       up != BSP_NONE && t->nodes[up].leaves <= BSP_GROUP_LEAVES;
+       up = t->nodes[up].parent) {
+    at = up;
+  }
+  while (!(at & BSP_LEAF)) {
+    const BspNode &n = t->nodes[at];
+    int l0 = refLeaves(t, n.child[0]);
+    int l1 = refLeaves(t, n.child[1]);
+    bool first = l0 != l1 ? l0 < l1
+                          : largerLeaf(t, refLargest(t, n.child[0]),
+                                       refLargest(t, n.child[1]));
+    at = n.child[first ? 0 : 1];
+  }
+
+  // A tree of n leaves has n - 1 internal nodes, so one is always free
+  int victim = at & ~BSP_LEAF;
+  uint8_t n = t->freeHead;
+  t->freeHead = t->nodes[n].parent;
+
+  uint8_t victimLeaf = BSP_LEAF | victim;
+  uint8_t p = t->leafParent[victim];
+  Rect area = leafRect(t, victim);
+  replaceChild(t, p, victimLeaf, n);
+  t->nodes[n].child[0] = victimLeaf;
+  t->nodes[n].child[1] = leaf;
+  t->nodes[n].leaves = 2;
+  t->leafParent[victim] = n;
+  t->leafParent[item] = n;
+
+  uint8_t top = countPath(t, p, 1);
+  if (top == BSP_NONE)
+    top = n;
+  else
+    area = nodeArea(t->nodes[top]);
+  place(t, top, area);
+  summarizePath(t, t->nodes[top].parent);
+  *damage = area;
+  return true;
+}
+
+bool HOT_FUNC(bsp_remove)(BspTree *t, int item, Rect *damage) {
+  if (item < 0 || item >= t->capacity || !bsp_contains(t, item))
+    return false;
+
+  uint8_t leaf = BSP_LEAF | item;
+  uint8_t p = t->leafParent[item];
+  t->leafParent[item] = BSP_ABSENT;
+
+  if (p == BSP_NONE) {
+    t->root = BSP_NONE;
+    *damage = leafRect(t, item);
+  } else {
+    BspNode &node = t->nodes[p];
+    uint8_t sibling = node.child[0] == leaf ? node.child[1] : node.child[0];
+    uint8_t g = node.parent;
+    Rect area = nodeArea(node);
+    replaceChild(t, g, p, sibling);
+    node.parent = t->freeHead;
+    t->freeHead = p;
+
+    uint8_t top = countPath(t, g, -1);
+    if (top == BSP_NONE) {
+      place(t, sibling, area);
+      summarizePath(t, g);
+    } else {
+      area = nodeArea(t->nodes[top]);
+      place(t, top, area);
+      summarizePath(t, t->nodes[top].parent);
+    }
+    *damage = area;
+  }
+  leafRect(t, item) = Rect{0, 0, 0, 0};
+  return true;
+}
+
+void HOT_FUNC(bsp_setArea)(BspTree *t, Rect area) {
+  t->area = area;
+  if (t->root != BSP_NONE)
+    place(t, t->root, area);
+}
+
+bool HOT_FUNC(bsp_contains)(const BspTree *t, int item) {
+  return t->leafParent[item] != BSP_ABSENT;
+}
@@ -0,0 +1,77 @@
+#ifndef BSP_H
+#define BSP_H
+
+#include "layout.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Persistent binary space partition.
+//
+// Leaves are items (channels or notes) that own a Rect; internal nodes
+// remember the area they divide, how many items they hold and which of them
+// is largest. A subtree of up to BSP_GROUP_LEAVES items shares its area
+// evenly; above that each node halves its area across the longer side.
+//
+// Inserting an item adds it to the group holding the largest leaf, and
+// removing one gives its area back to its sibling subtree. Only that group
+// (or that subtree) moves; the rest of the work is the O(depth) update of
+// the counts on the path to the root. Each operation reports the area that
+// changed.
+//
+// Leaf rects are written in place: item i's Rect lives at
+// leafRects + i * leafStride bytes (e.g. &notes[0].bounds, sizeof(NoteEntry)).
+
+#define BSP_NONE 0x7F   // No node (never a valid internal node index)
+#define BSP_LEAF 0x80   // Child reference flag: low 7 bits are an item
+#define BSP_ABSENT 0xFF // leafParent value for items not in the tree
+
+// Subtrees up to this size share their area evenly. Bigger groups keep tile
+// sizes closer but move more tiles per change.
+#define BSP_GROUP_LEAVES 4
+
+// Node areas hold layout coordinates (8.8 fixed point with LAYOUT_SUBPIXEL)
+#if LAYOUT_SUBPIXEL
+typedef uint16_t bsp_coord_t;
+#else
+typedef uint8_t bsp_coord_t;
+#endif
+
+struct BspNode {
+  uint8_t parent;         // Internal node index, BSP_NONE at the root
+  uint8_t child[2];       // BSP_LEAF | item, or an internal node index
+  uint8_t leaves;         // Items in this subtree
+  uint8_t largest;        // Largest leaf in this subtree (an item)
+  bsp_coord_t x, y, w, h; // Area covered by this subtree
+};
+
+struct BspTree {
+  Rect area;           // Region being divided
+  uint8_t root;        // BSP_LEAF | item, internal index, or BSP_NONE
+  uint8_t freeHead;    // Free internal nodes, linked through parent
+  uint8_t capacity;    // Maximum number of items
+  BspNode *nodes;      // capacity - 1 internal nodes
+  uint8_t *leafParent; // Per item: parent node, BSP_NONE or BSP_ABSENT
+  uint8_t *leafRects;
+  size_t leafStride;
+};
+
+// Attach storage. capacity is at most 128 items.
+void bsp_init(BspTree *t, BspNode *nodes, uint8_t *leafParent, int capacity,
+              Rect *leafRects, size_t leafStride);
+
+// Remove every item and set the area to divide
+void bsp_clear(BspTree *t, Rect area);
+
+// Add an item next to the largest leaf. Returns false if the item is
+// already present. damage receives the area whose tiles changed.
+bool bsp_insert(BspTree *t, int item, Rect *damage);
+
+// Remove an item; its sibling subtree takes over the freed area
+bool bsp_remove(BspTree *t, int item, Rect *damage);
+
+// Move the whole tree onto a new area, keeping its structure
+void bsp_setArea(BspTree *t, Rect area);
+
+bool bsp_contains(const BspTree *t, int item);
+
+#endif // BSP_H
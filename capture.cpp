@@ -0,0 +1,232 @@
+#include "capture.h"
+#include "config.h"
+#include "console.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "pico/stdlib.h"
+#include <cstdio>
+#include <string.h>
+
+static_assert((CAPTURE_RAM_ENTRIES & (CAPTURE_RAM_ENTRIES - 1)) == 0,
+              "CAPTURE_RAM_ENTRIES must be a power of 2");
+static_assert(CAPTURE_FLASH_BYTES % FLASH_SECTOR_SIZE == 0,
+              "Capture region must be whole erase sectors");
+
+static const uint32_t RAM_MASK = CAPTURE_RAM_ENTRIES - 1;
+static const uint32_t PAGE_ENTRIES = FLASH_PAGE_SIZE / sizeof(CaptureEntry);
+static const uint32_t FLASH_ENTRIES = CAPTURE_FLASH_BYTES / sizeof(CaptureEntry);
+static const uint32_t FLASH_OFFSET =
+    PICO_FLASH_SIZE_BYTES - CAPTURE_FLASH_BYTES; // Last bytes of flash
+
+extern char __flash_binary_end; // From the linker script
+
+// ============================================================================
+// State
+// ============================================================================
+
+// RAM ring. Entry i of the capture lives at ring[i & RAM_MASK] until it is
+// overwritten CAPTURE_RAM_ENTRIES entries later.
+static CaptureEntry ring[CAPTURE_RAM_ENTRIES];
+static uint32_t head = 0; // Entries recorded since capture start
+static bool recording = false;
+static uint32_t lastByteUs = 0;
+
+// Flash spill. Entries [0, spilled) of the capture are in flash.
+static bool spilling = false;
+static uint32_t spilled = 0;
+static uint32_t flashCount = 0; // Entries in flash (may exceed spilled + lost)
+static uint32_t lost = 0;       // Overwritten before they could be spilled
+static bool gapPending = false;
+static uint32_t inputGaps = 0; // Input lost before it reached us
+static CaptureEntry page[PAGE_ENTRIES];
+
+static const CaptureEntry *flashEntries() {
+  return (const CaptureEntry *)(XIP_BASE + FLASH_OFFSET);
+}
+
+// ============================================================================
+// Flash Access
+// ============================================================================
+
+// Both run with interrupts disabled and XIP off (via flash_safe_execute)
+static void eraseSector(void *param) {
+  uint32_t sector = (uint32_t)(uintptr_t)param;
+  flash_range_erase(FLASH_OFFSET + sector * FLASH_SECTOR_SIZE,
+                    FLASH_SECTOR_SIZE);
+}
+
+static void programPage(void *param) {
+  flash_range_program(FLASH_OFFSET + flashCount * sizeof(CaptureEntry),
+                      (const uint8_t *)param, FLASH_PAGE_SIZE);
+}
+
+// Count the entries of a capture left in flash (pages are written whole)
+static uint32_t scanFlash() {
+  const CaptureEntry *e = flashEntries();
+  uint32_t n = 0;
+  while (n < FLASH_ENTRIES && e[n].flags != 0xFF) {
+    n += PAGE_ENTRIES;
+  }
+  return n;
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+static void start(bool spill) {
+  recording = false;
+  head = 0;
+  spilled = 0;
+  lost = 0;
+  inputGaps = 0;
+  gapPending = false;
+  spilling = false;
+
+  if (spill) {
+    if ((uintptr_t)&__flash_binary_end > XIP_BASE + FLASH_OFFSET) {
+      printf("Capture: flash region overlaps the firmware\n");
+      return;
+    }
+    // Erase everything now, so nothing longer than a page write stalls
+    // the input once recording. One sector at a time lets USB run between.
+    printf("Capture: erasing %d KB of flash\n", CAPTURE_FLASH_BYTES / 1024);
+    stdio_flush();
+    flashCount = 0;
+    for (uint32_t s = 0; s < CAPTURE_FLASH_BYTES / FLASH_SECTOR_SIZE; s++) {
+      if (flash_safe_execute(eraseSector, (void *)(uintptr_t)s, UINT32_MAX) !=
+          PICO_OK) {
+        printf("Capture: flash erase failed\n");
+        return;
+      }
+    }
+    spilling = true;
+  }
+
+  recording = true;
+  printf("Capture: recording%s\n", spill ? " (flash spill)" : "");
+}
+
+static void dump(bool fromFlash) {
+  if (recording) {
+    recording = false;
+    printf("Capture: stopped\n");
+  }
+
+  // Unspilled tail still in RAM (none when dumping a stored capture)
+  uint32_t ramStart = spilled + lost;
+  uint32_t ramLost = 0;
+  if (fromFlash) {
+    ramStart = head;
+  } else if (head - ramStart > CAPTURE_RAM_ENTRIES) {
+    ramLost = head - ramStart - CAPTURE_RAM_ENTRIES;
+    ramStart = head - CAPTURE_RAM_ENTRIES;
+  }
+  uint32_t flashN = (fromFlash || spilled > 0) ? flashCount : 0;
+
+  CaptureHeader hdr;
+  hdr.magic = CAPTURE_MAGIC;
+  hdr.version = CAPTURE_VERSION;
+  hdr.entrySize = sizeof(CaptureEntry);
+  hdr.count = flashN + (head - ramStart);
+  hdr.lost = fromFlash ? 0 : lost + ramLost + inputGaps;
+
+  printf("CAPTURE %lu\n", (unsigned long)(sizeof(hdr) +
+                                          hdr.count * sizeof(CaptureEntry)));
+  console_writeRaw(&hdr, sizeof(hdr));
+  console_writeRaw(flashEntries(), flashN * sizeof(CaptureEntry));
+  for (uint32_t i = ramStart; i < head; i++) {
+    CaptureEntry e = ring[i & RAM_MASK];
+    if (i == ramStart && (ramLost > 0 || gapPending))
+      e.flags |= CAPTURE_FLAG_GAP;
+    console_writeRaw(&e, sizeof(e));
+  }
+  printf("\nCAPTURE END\n");
+}
+
+static void captureCommand(int argc, char **argv) {
+  const char *sub = argc > 1 ? argv[1] : "";
+  bool flash = argc > 2 && strcmp(argv[2], "flash") == 0;
+
+  if (strcmp(sub, "start") == 0) {
+    start(flash);
+  } else if (strcmp(sub, "stop") == 0) {
+    recording = false;
+    printf("Capture: stopped at %lu entries\n", (unsigned long)head);
+  } else if (strcmp(sub, "dump") == 0) {
+    dump(flash);
+  } else {
+    printf("Capture: %s, %lu entries, %lu in flash, %lu lost\n",
+           recording ? "recording" : "stopped", (unsigned long)head,
+           (unsigned long)flashCount, (unsigned long)(lost + inputGaps));
+    printf("Usage: capture start [flash] | stop | dump [flash]\n");
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void capture_init() {
+  flashCount = scanFlash();
+  if (flashCount > 0)
+    printf("Capture: %lu entries stored in flash\n", (unsigned long)flashCount);
+
+  console_addCommand("capture", captureCommand,
+                     "Record MIDI input: start [flash] | stop | dump [flash]");
+#if CAPTURE_AT_BOOT
+  start(false);
+#endif
+}
+
+void capture_record(uint8_t port, uint8_t b, uint32_t t_us, bool gap) {
+  if (!recording)
+    return;
+  if (gap)
+    inputGaps++;
+  ring[head & RAM_MASK] = {t_us, b, port,
+                           (uint8_t)(gap ? CAPTURE_FLAG_GAP : 0), 0};
+  head++;
+  lastByteUs = t_us;
+}
+
+void capture_service(uint32_t now_us) {
+  if (!spilling)
+    return;
+
+  // Anything the ring overwrote before we got to it is gone
+  uint32_t next = spilled + lost;
+  if (head - next > CAPTURE_RAM_ENTRIES) {
+    lost += head - next - CAPTURE_RAM_ENTRIES;
+    next = head - CAPTURE_RAM_ENTRIES;
+    gapPending = true;
+  }
+
+  // Programming a page stalls interrupts for about 1 ms; with the UART
+  // FIFO off, only do it after a long pause in the input. A byte that still
+  // arrives overruns the UART and is recorded as a gap (capture_record).
+  // One page per run.
+  if (now_us - lastByteUs < CAPTURE_QUIET_US)
+    return;
+
+  if (head - next < PAGE_ENTRIES)
+    return;
+
+  if (flashCount + PAGE_ENTRIES > FLASH_ENTRIES) {
+    spilling = false;
+    printf("Capture: flash full, keeping the rest in RAM\n");
+    return;
+  }
+
+  for (uint32_t i = 0; i < PAGE_ENTRIES; i++) {
+    page[i] = ring[(next + i) & RAM_MASK];
+  }
+  if (gapPending)
+    page[0].flags |= CAPTURE_FLAG_GAP;
+
+  if (flash_safe_execute(programPage, page, UINT32_MAX) != PICO_OK)
+    return;
+  gapPending = false;
+  spilled += PAGE_ENTRIES;
+  flashCount += PAGE_ENTRIES;
+}
@@ -0,0 +1,56 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+// MIDI traffic capture.
+//
+// Every byte handed to the parser is recorded with its ingest timestamp into
+// a RAM ring (the most recent CAPTURE_RAM_ENTRIES bytes). Optionally, full
+// pages are spilled to a flash region during pauses in the traffic, which
+// extends the capture and keeps it across a reset. The region is erased
+// when that capture starts, so only page writes happen while playing.
+//
+// 'capture dump' on the console sends the capture as a CaptureHeader
+// followed by CaptureEntry records; tools/capture_replay.cpp feeds them back
+// through the same parser on a host.
+
+#define CAPTURE_MAGIC 0x5041434Du // "MCAP"
+#define CAPTURE_VERSION 1
+
+// Entry flags
+#define CAPTURE_FLAG_GAP 0x01 // Entries were lost right before this one
+
+// A gap in the input itself (UART overrun, full receive ring) counts as one
+// lost entry, though more bytes may be missing.
+
+struct CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t entrySize; // sizeof(CaptureEntry)
+  uint32_t count;     // Entries that follow
+  uint32_t lost;      // Entries dropped (ring overflow, input gaps)
+};
+
+struct CaptureEntry {
+  uint32_t t_us; // Ingest time, us since boot
+  uint8_t b;
+  uint8_t port;  // Input port the byte arrived on
+  uint8_t flags; // CAPTURE_FLAG_*; 0xFF marks erased flash
+  uint8_t reserved;
+};
+
+static_assert(sizeof(CaptureHeader) == 16, "Capture header layout");
+static_assert(sizeof(CaptureEntry) == 8, "Capture entry layout");
+
+// Register console commands and start recording if CAPTURE_AT_BOOT
+void capture_init();
+
+// Record one byte as it is passed to the parser. gap: input bytes were lost
+// right before it (UART overrun or a full receive ring).
+void capture_record(uint8_t port, uint8_t b, uint32_t t_us, bool gap);
+
+// Spill pending entries to flash when the input has been quiet
+void capture_service(uint32_t now_us);
+
+#endif // CAPTURE_H
@@ -8,15 +8,23 @@
 
 // UART0 for MIDI input (31,250 baud)
 #define MIDI_UART_ID uart0
-#define MIDI_TX_PIN 0 // Reserved but unused
+#define MIDI_TX_PIN 0 // MIDI thru/merge output
 #define MIDI_RX_PIN 1 // MIDI input from opto-isolator
 
-// WS2812B LED data output (PIO0, SM0)
+// UART1 for the second MIDI input (only RX is used; GPIO 4 stays free)
+#define MIDI2_UART_ID uart1
+#define MIDI2_RX_PIN 5
+
+// LED data output (PIO0, SM0), plus the clock for clocked strips
 #define LED_PIN 2
+#define LED_CLK_PIN 6
 
 // Reset Button (Active Low, Pull-Up)
 #define RESET_BTN_PIN 3
 #define RESET_BUTTON_FLASH_TIME 250
+// Holding the button at least this long switches visualization mode
+// instead of resetting
+#define MODE_SWITCH_HOLD_MS 1000
 
 // Stacked Layout:
 // Multiple 32x8 panels stacked vertically.
@@ -28,17 +36,231 @@
 // Global brightness (0-255).
 extern uint8_t global_brightness;
 
+// LED chain type. The renderer does not care: pixels are encoded for the
+// strip while the frame is transmitted.
+//   LED_DRIVER_WS2812      - WS2812B, 24-bit GRB at 800 kHz (30 us/LED)
+//   LED_DRIVER_WS2812_RGBW - SK6812 RGBW, 32-bit GRBW at 800 kHz (40 us/LED);
+//                            white takes the part common to R, G and B
+//   LED_DRIVER_APA102      - APA102/SK9822, clocked on LED_CLK_PIN at
+//                            LED_CLOCK_HZ (3.2 us/LED at 10 MHz), no latch
+#define LED_DRIVER_WS2812 0
+#define LED_DRIVER_WS2812_RGBW 1
+#define LED_DRIVER_APA102 2
+#define LED_DRIVER LED_DRIVER_WS2812
+#define LED_CLOCK_HZ 10000000
+
+// Indexed framebuffer: 1 byte per LED instead of 4. Palette entries are
+// expanded to wire format (with brightness) while the frame is transmitted.
+// The afterglow layer needs full-color pixels and is skipped in this mode.
+#define LED_INDEXED_FRAMEBUFFER 0
+
+// Palette layout: 0 = black, channel colors from PALETTE_CHANNEL_BASE, and a
+// 6x6x6 color cube from PALETTE_CUBE_BASE for leds_setPixel()
+#define PALETTE_CHANNEL_BASE 1
+#define PALETTE_CUBE_BASE 40
+
+// Sub-pixel layout: tile rects are 8.8 fixed point (1/256 pixel), so tiles
+// never collapse to nothing however many notes a channel has. Partly covered
+// edge pixels are blended by coverage, and a lit tile always shows at least
+// LAYOUT_MIN_COVERAGE/256 of its color, as a dim sliver if need be.
+#define LAYOUT_SUBPIXEL 1
+#define LAYOUT_MIN_COVERAGE 48
+
 // Potentiometer Configuration
 #define POT_PIN 26
 #define POT_ADC_NUM 0          // ADC0 is on GPIO26
 #define ENABLE_POTENTIOMETER 1 // Set to 0 if no pot connected
 
+// ============================================================================
+// Multi-Board Link
+// ============================================================================
+
+// Larger walls chain several boards, each driving its own 32 x PANEL_HEIGHT
+// slice stacked vertically. The master parses MIDI, computes the layout for
+// the whole wall and broadcasts it over SPI; followers only render.
+#define LINK_ROLE_NONE 0
+#define LINK_ROLE_MASTER 1
+#define LINK_ROLE_FOLLOWER 2
+
+#define LINK_ROLE LINK_ROLE_NONE
+#define LINK_NODE_COUNT 1 // Boards in the wall (master included)
+#define LINK_NODE_INDEX 0 // This board's slice, top to bottom (master = 0)
+
+// SPI0, mode 3. Master TX (GPIO19) fans out to every follower's RX (GPIO16);
+// SCK and CSn are shared.
+#define LINK_SPI spi0
+#define LINK_BAUD 4000000 // Followers need clk_peri >= 12x this
+#define LINK_SCK_PIN 18
+#define LINK_CS_PIN 17
+#define LINK_TX_PIN 19 // Master data out
+#define LINK_RX_PIN 16 // Follower data in
+
+// Resend one channel's full state every N frames so late-booting followers
+// converge
+#define LINK_REFRESH_FRAMES 8
+
+// Layout coordinate space covers the whole wall
+#define WALL_WIDTH PANEL_WIDTH
+#define WALL_HEIGHT (PANEL_HEIGHT * LINK_NODE_COUNT)
+
 // ============================================================================
 // MIDI Configuration
 // ============================================================================
 
 #define MIDI_BAUD_RATE 31250
-#define MAX_CHANNELS 16
 #define MAX_NOTES 128
 
+// DIN inputs. Each port is a bank of 16 logical channels (port 2, MIDI
+// channel 1 is logical channel 17). Set to 1 if the second input is not
+// fitted.
+#define MIDI_PORTS 2
+#define MAX_CHANNELS (16 * MIDI_PORTS)
+#define MIDI_CLOCK_PORT 0 // Only this port drives the beat clock
+
+// Note tables are taken from a pool when a channel is first seen, so
+// channels that never play cost a few bytes instead of a full table
+#define CHANNEL_SLOTS 16
+
+// Bytes buffered per port between the UART RX interrupt and midi_poll()
+// (power of 2). Each byte takes 320 us at 31,250 baud, so 256 is ~80 ms.
+#define MIDI_RX_RING_SIZE 256
+
+// MIDI output on MIDI_TX_PIN:
+//   MIDI_THRU_RAW   - copy port 0 byte for byte (lowest latency); the second
+//                     input is not forwarded
+//   MIDI_THRU_MERGE - merge all inputs plus midithru_send(), re-encoded with
+//                     running status; SysEx passes one port at a time
+// Use MERGE whenever MIDI_PORTS > 1, or the second rig goes nowhere.
+#define MIDI_THRU_OFF 0
+#define MIDI_THRU_RAW 1
+#define MIDI_THRU_MERGE 2
+#define MIDI_THRU_MODE MIDI_THRU_MERGE
+#define MIDI_THRU_RING_BITS 8 // Output ring size, log2 (~80 ms at 31,250)
+#define MIDI_THRU_SYSEX_TIMEOUT_MS 200 // Merge: release a SysEx gone silent
+
+// Print every parsed byte and dispatched message over USB serial
+#define MIDI_DEBUG_TRACE 0
+
+// Beat-synced pulse: when a running MIDI clock is received, active notes
+// flash on each beat and decay to (256 - BEAT_PULSE_DEPTH) / 256 brightness
+#define ENABLE_BEAT_PULSE 1
+#define BEAT_PULSE_DEPTH 160
+
+// MPE zones, per input port. Member channels share their manager channel's
+// tile instead of each getting a tile of their own; a note's pitch bend
+// slides its tile and channel pressure sets its brightness. Zones come from
+// the MPE Configuration Message, or are preset here (member channel count,
+// 0 = none).
+#define ENABLE_MPE 1
+#define MPE_LOWER_ZONE_MEMBERS 0
+#define MPE_UPPER_ZONE_MEMBERS 0
+#define MPE_SEMITONES_PER_TILE 2 // Bend that moves a tile by its own width
+#define MPE_PRESSURE_FLOOR 96    // Brightness (of 256) at zero pressure
+
+// Afterglow layer: released notes fade out over AFTERGLOW_US (half a beat
+// while a MIDI clock is running) instead of cutting to black
+#define ENABLE_AFTERGLOW (!LED_INDEXED_FRAMEBUFFER)
+#define AFTERGLOW_US 250000
+
+// Time the blend kernels against scalar code at boot
+#define ENABLE_BLEND_BENCH 0
+
+// ============================================================================
+// Console / Capture Configuration
+// ============================================================================
+
+#define CONSOLE_MAX_COMMANDS 8
+
+// Record MIDI input from boot so the traffic before a problem is available
+// ('capture dump' on the USB console)
+#define CAPTURE_AT_BOOT 1
+#define CAPTURE_RAM_ENTRIES 4096          // 8 bytes each, power of 2
+#define CAPTURE_FLASH_BYTES (256 * 1024)  // Spill region at the end of flash
+#define CAPTURE_QUIET_US 250000           // Input silence before a flash write
+
+// 'capture start flash' erases the whole spill region on the spot (a few
+// seconds with the wall frozen), so run it before the performance. After
+// that each page write stalls interrupts for about 1 ms. The UART FIFO is
+// off, so a byte arriving during the stall is lost and recorded as a gap;
+// waiting CAPTURE_QUIET_US makes that unlikely but not impossible. Playing
+// with no such pause for longer than the RAM ring holds loses entries too.
+
+// ============================================================================
+// Performance Configuration
+// ============================================================================
+
+// Run the parser, layout and render hot path from SRAM instead of flash
+// (see hotpath.h). Compare with the 'bench' console command.
+#define HOT_PATH_IN_RAM 0
+
+// ============================================================================
+// Power Configuration
+// ============================================================================
+
+// After IDLE_TIMEOUT_MS without note events, show one black frame, run
+// clk_sys from the 48 MHz USB PLL and sleep until MIDI or USB input arrives.
+// UART/SPI clocks move to the USB PLL at boot so their baud rates never change.
+// That caps LINK_BAUD at 4 MHz: a follower's SPI needs clk_peri >= 12 x SCK.
+// The saving comes from the lower clock, not from WFI: the stdio_usb
+// background timer fires every 1 ms, so a WFI rarely lasts longer than that.
+// Off by default until measured on the target supply.
+#define ENABLE_IDLE_POWERDOWN 0
+#define IDLE_TIMEOUT_MS 60000
+
+// ============================================================================
+// Standalone Show Configuration
+// ============================================================================
+
+// Standard MIDI Files (type 0/1), stored back to back in the flash region
+// just below the capture region, play in a loop once no live channel
+// message has arrived for SHOW_AUTOSTART_MS (clock and active sensing do not
+// count). Any live channel message stops the show. The files are read in
+// place through XIP; RAM use does not depend on their size.
+#define ENABLE_SHOW 1
+#define SHOW_FLASH_BYTES (512 * 1024)
+#define SHOW_AUTOSTART_MS 30000
+#define SHOW_MAX_TRACKS 16 // Further tracks of a type 1 file are skipped
+#define SHOW_GAP_MS 2000   // Pause between files
+
+// ============================================================================
+// Frame Mirror Configuration
+// ============================================================================
+
+// 'mirror on' streams every shown frame to the USB host as RLE deltas
+// (tools/mirror_view.py). Off at boot. A keyframe every
+// MIRROR_KEYFRAME_FRAMES lets a viewer join or recover from lost bytes.
+#define ENABLE_MIRROR 1
+#define MIRROR_KEYFRAME_FRAMES 120
+
+// ============================================================================
+// Piano Roll Configuration
+// ============================================================================
+
+// Pitch range spread over PANEL_HEIGHT rows (default C2..D#7)
+#define ROLL_LOW_NOTE 36
+#define ROLL_NOTE_SPAN 64
+// Scroll interval when no MIDI clock is running
+#define ROLL_STEP_US 62500
+
+// ============================================================================
+// Scheduler Configuration
+// ============================================================================
+
+#define SCHEDULER_MAX_TASKS 10
+
+// Frame interval adapts to the measured transmit time for LED_COUNT plus a
+// margin, but never runs faster than FRAME_MIN_INTERVAL_US (~120 FPS)
+#define FRAME_MIN_INTERVAL_US 8000
+#define FRAME_MARGIN_US 500
+
+#define MIDI_DRAIN_INTERVAL_US 1000 // MIDI_RX_RING_SIZE holds ~80 ms
+#define INPUT_INTERVAL_US 10000     // Button debounce / pot sampling
+#define HEARTBEAT_INTERVAL_US 500000
+#define TELEMETRY_INTERVAL_US 5000000
+#define CONSOLE_INTERVAL_US 20000
+#define CAPTURE_INTERVAL_US 2000
+#define LINK_POLL_INTERVAL_US 250 // Follower link drain (~125 bytes at 4 MHz)
+#define SHOW_INTERVAL_US 100000   // Live input check; events wake it sooner
+#define MIRROR_INTERVAL_US 1000   // USB FIFO refill (256 bytes per run)
+
 #endif // CONFIG_H
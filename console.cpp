@@ -0,0 +1,154 @@
+#include "console.h"
+#include "config.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include <cstdio>
+#include <string.h>
+
+static const int LINE_MAX = 80;
+static const int MAX_ARGS = 8;
+
+struct ConsoleCommand {
+  const char *name;
+  ConsoleCommandFn fn;
+  const char *help;
+};
+
+static ConsoleCommand commands[CONSOLE_MAX_COMMANDS];
+static int commandCount = 0;
+
+static char line[LINE_MAX];
+static int lineLen = 0;
+
+static ConsoleStreamFinishFn stream = nullptr;
+static bool inCommand = false; // Command output always goes out
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// While a stream is set the USB stdio driver is only attached around the
+// console's own I/O and commands, so printf() from anywhere else is dropped
+static void attachUsb() {
+  if (stream && !inCommand)
+    stdio_set_driver_enabled(&stdio_usb, true);
+}
+
+static void detachUsb() {
+  if (stream && !inCommand)
+    stdio_set_driver_enabled(&stdio_usb, false);
+}
+
+static void runCommand(ConsoleCommandFn fn, int argc, char **argv) {
+  if (stream) {
+    stream(); // Finish the packet in flight
+    stdio_set_driver_enabled(&stdio_usb, true);
+    putchar_raw('\n'); // Headers start a line, whatever the packet ended with
+  }
+  inCommand = true;
+  fn(argc, argv);
+  inCommand = false;
+  stdio_set_driver_enabled(&stdio_usb, stream == nullptr);
+}
+
+static void printHelp(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  printf("Commands:\n");
+  for (int i = 0; i < commandCount; i++) {
+    printf("  %-10s %s\n", commands[i].name, commands[i].help);
+  }
+}
+
+static void unknownCommand(int argc, char **argv) {
+  (void)argc;
+  printf("Unknown command '%s' (try 'help')\n", argv[0]);
+}
+
+// Split the line in place and run the matching command
+static void execute(char *s) {
+  char *argv[MAX_ARGS];
+  int argc = 0;
+  char *save = nullptr;
+  for (char *tok = strtok_r(s, " \t", &save); tok && argc < MAX_ARGS;
+       tok = strtok_r(nullptr, " \t", &save)) {
+    argv[argc++] = tok;
+  }
+  if (argc == 0)
+    return;
+
+  if (strcmp(argv[0], "help") == 0) {
+    runCommand(printHelp, argc, argv);
+    return;
+  }
+  for (int i = 0; i < commandCount; i++) {
+    if (strcmp(argv[0], commands[i].name) == 0) {
+      runCommand(commands[i].fn, argc, argv);
+      return;
+    }
+  }
+  runCommand(unknownCommand, argc, argv);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool console_addCommand(const char *name, ConsoleCommandFn fn,
+                        const char *help) {
+  if (commandCount >= CONSOLE_MAX_COMMANDS)
+    return false;
+  commands[commandCount++] = {name, fn, help};
+  return true;
+}
+
+bool console_poll() {
+  bool any = false;
+  while (true) {
+    attachUsb();
+    int c = getchar_timeout_us(0);
+    detachUsb();
+    if (c == PICO_ERROR_TIMEOUT)
+      break;
+    any = true;
+    if (c == '\r' || c == '\n') {
+      line[lineLen] = '\0';
+      lineLen = 0;
+      execute(line);
+    } else if (lineLen < LINE_MAX - 1) {
+      line[lineLen++] = (char)c;
+    }
+  }
+  return any;
+}
+
+void console_writeRaw(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  attachUsb();
+  for (size_t i = 0; i < len; i++) {
+    putchar_raw(p[i]);
+  }
+  detachUsb();
+}
+
+size_t console_writeSome(const void *data, size_t len) {
+  if (!stdio_usb_connected())
+    return 0;
+  // stdio only blocks when the FIFO is full, so stay within the free space
+  size_t room = tud_cdc_write_available();
+  if (len > room)
+    len = room;
+  if (len > 0) {
+    attachUsb();
+    stdio_put_string((const char *)data, (int)len, false, false);
+    detachUsb();
+  }
+  return len;
+}
+
+void console_setStream(ConsoleStreamFinishFn finish) {
+  stream = finish;
+  if (!inCommand) // Otherwise runCommand() sets it once the command is done
+    stdio_set_driver_enabled(&stdio_usb, finish == nullptr);
+}
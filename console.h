@@ -0,0 +1,38 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stddef.h>
+
+// Line-based command console on USB serial.
+//
+// Modules register commands at init; console_poll() (run as a task) reads
+// whatever has arrived without blocking and runs each complete line.
+
+// Command handler. argv[0] is the command name.
+typedef void (*ConsoleCommandFn)(int argc, char **argv);
+
+// Register a command. Returns false if the table is full.
+bool console_addCommand(const char *name, ConsoleCommandFn fn,
+                        const char *help);
+
+// Read pending input and dispatch complete lines. Returns true if any input
+// arrived.
+bool console_poll();
+
+// Write binary data without newline translation
+void console_writeRaw(const void *data, size_t len);
+
+// Write as much of data as the USB CDC transmit FIFO takes right now, without
+// blocking. Returns the number of bytes written (0 if no host is connected).
+size_t console_writeSome(const void *data, size_t len);
+
+// A binary stream of packets on USB (the mirror). While one is set,
+// printf() output from outside commands is dropped, so text cannot land
+// inside a packet. Before a command runs, finish() completes the packet
+// being written; the command's text and binary output (e.g. the CAPTURE and
+// TELEMETRY blocks) then go out whole between two packets, starting on a
+// new line. nullptr ends the stream.
+typedef void (*ConsoleStreamFinishFn)();
+void console_setStream(ConsoleStreamFinishFn finish);
+
+#endif // CONSOLE_H
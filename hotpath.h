@@ -0,0 +1,25 @@
+#ifndef HOTPATH_H
+#define HOTPATH_H
+
+#include "config.h"
+
+// HOT_FUNC(name) marks a function on the MIDI -> layout -> render path.
+// With HOT_PATH_IN_RAM it is linked into SRAM (copied there at boot by the
+// SDK's .time_critical sections) instead of executing in place from QSPI
+// flash through the XIP cache, so cache misses cannot add jitter.
+//
+// HOT_DATA does the same for a const table those functions read, which
+// would otherwise stay in flash with the rest of .rodata.
+//
+// Host builds (tools/) have no pico.h and always get the plain function.
+
+#if HOT_PATH_IN_RAM && __has_include("pico.h")
+#include "pico.h"
+#define HOT_FUNC(name) __not_in_flash_func(name)
+#define HOT_DATA __not_in_flash("hot_data")
+#else
+#define HOT_FUNC(name) name
+#define HOT_DATA
+#endif
+
+#endif // HOTPATH_H
@@ -1,214 +1,331 @@
-#include "layout.h"
-#include <cstdio>
-#include <string.h>
-
-// ============================================================================
-// Global State
-// ============================================================================
-
-ChannelEntry channels[MAX_CHANNELS];
-int activeChannelCount = 0;
-
-// ============================================================================
-// Color Palette
-// ============================================================================
-
-//// original colors
-// static const uint32_t CHANNEL_COLORS[16] = {
-//     0xFF0000, // ch 0  Red
-//     0xFF8000, // ch 1  Orange
-//     0xFFFF00, // ch 2  Yellow
-//     0x80FF00, // ch 3  Chartreuse
-//     0x00FF00, // ch 4  Green
-//     0x00FF80, // ch 5  Spring Green
-//     0x00FFFF, // ch 6  Cyan
-//     0x0080FF, // ch 7  Azure
-//     0x0000FF, // ch 8  Blue
-//     0x8000FF, // ch 9  Violet
-//     0xFF00FF, // ch 10 Magenta
-//     0xFF0080, // ch 11 Rose
-//     0x8B4513, // ch 12 SaddleBrown
-//     0x008080, // ch 13 Teal
-//     0x800080, // ch 14 Purple
-//     0x708090, // ch 15 SlateGray
-// };
-
-//// Colors tuned to match my LEDs
-static const uint32_t CHANNEL_COLORS[16] = {
-    0xFF7A00, // ch 1  Amber
-
-    0xFF6BFF, // ch 2  Light pinkish purple (requested)
-
-    0x0037FF, // ch 3  Strong blue (requested)
-
-    0xFFFF00, // ch 4  Yellow
-
-    0x00B84A, // ch 5  Slightly blueish green (requested)
-
-    0xFF00FF, // ch 6  Magenta (requested)
-
-    0xFF0000, // ch 7  Strong red (requested)
-
-    0x00E6FF, // ch 8  Cyan
-
-    0x6A00FF, // ch 9  Violet
-
-    0x73FF00, // ch10  Chartreuse
-
-    0xFF2E73, // ch11  Rose
-
-    0x0073FF, // ch12  Azure
-
-    0x00FF00, // ch13  Pure green
-
-    0xFF7300, // ch14  Orange
-
-    0x006060, // ch15  Teal
-
-    0x9A9A9A, // ch16  Light gray
-};
-
-// ============================================================================
-// Recursive Binary Space Partitioning (BSP) for Layout
-// ============================================================================
-
-// Helper: Split a parent rect into N sections recursively
-void computeTiling(Rect area, int n, Rect **out_rects) {
-  if (n <= 0)
-    return;
-
-  // Base case: One item gets the whole area
-  if (n == 1) {
-    *(out_rects[0]) = area;
-    return;
-  }
-
-  // Split decision: Cut the longer Dimension to keep aspect ratio square-ish
-  bool splitVertically = (area.w >= area.h);
-
-  // Split items roughly in half
-  int k = n / 2; // Items in first part
-
-  Rect parts[2];
-
-  if (splitVertically) {
-    // Split Width
-    int w1 = (area.w * k) / n;
-    int w2 = area.w - w1;
-    parts[0] = {area.x, area.y, w1, area.h};
-    parts[1] = {area.x + w1, area.y, w2, area.h};
-  } else {
-    // Split Height
-    int h1 = (area.h * k) / n;
-    int h2 = area.h - h1;
-    parts[0] = {area.x, area.y, area.w, h1};
-    parts[1] = {area.x, area.y + h1, area.w, h2};
-  }
-
-  // Recurse Left (k items)
-  computeTiling(parts[0], k, out_rects);
-
-  // Recurse Right (n-k items)
-  computeTiling(parts[1], n - k, out_rects + k);
-}
-
-// Recompute regions for all active channels (2D Tiled)
-void recomputeLayout() {
-  if (activeChannelCount == 0)
-    return;
-
-  // 1. Gather pointers to active channels for the tiler
-  Rect *targets[MAX_CHANNELS];
-  int t_idx = 0;
-  ChannelEntry *activePtrs[MAX_CHANNELS];
-
-  for (int c = 0; c < MAX_CHANNELS; c++) {
-    if (channels[c].seen) {
-      activePtrs[t_idx] = &channels[c];
-      targets[t_idx] = &channels[c].bounds;
-      t_idx++;
-    }
-  }
-
-  // 2. Compute Tiling for Channels
-  Rect fullScreen = {0, 0, PANEL_WIDTH, PANEL_HEIGHT};
-  if (t_idx > 0) {
-    printf("Recomputing Layout 2D: %d items\n", t_idx);
-    computeTiling(fullScreen, t_idx, targets);
-  }
-
-  // 3. Recompute Note Layouts for each channel
-  for (int i = 0; i < t_idx; i++) {
-    ChannelEntry *ch = activePtrs[i];
-
-    // Count SEEN notes in this channel (for stable tiling)
-    int seenNotes = 0;
-    Rect *noteTargets[MAX_NOTES];
-
-    for (int n = 0; n < MAX_NOTES; n++) {
-      // Only condition is that the note has been seen
-      if (ch->notes[n].seen) {
-        noteTargets[seenNotes] = &ch->notes[n].bounds;
-        seenNotes++;
-      }
-    }
-
-    if (seenNotes > 0) {
-      printf("  Ch %d: %d seen notes (tiling)\n", i, seenNotes);
-      computeTiling(ch->bounds, seenNotes, noteTargets);
-    }
-  }
-}
-
-// ============================================================================
-// Public API
-// ============================================================================
-
-void layout_init() { layout_reset(); }
-
-void layout_reset() {
-  memset(channels, 0, sizeof(channels));
-  activeChannelCount = 0;
-  printf("Layout Reset!\n");
-}
-
-void registerChannel(int channel) {
-  if (channel < 0 || channel >= MAX_CHANNELS)
-    return;
-
-  if (!channels[channel].seen) {
-    channels[channel].seen = true;
-    channels[channel].color = CHANNEL_COLORS[channel];
-    channels[channel].seenNoteCount = 0;
-    activeChannelCount++;
-    recomputeLayout();
-  }
-}
-
-void registerNote(int channel, int note) {
-  if (channel < 0 || channel >= MAX_CHANNELS)
-    return;
-  if (note < 0 || note >= MAX_NOTES)
-    return;
-
-  ChannelEntry &ch = channels[channel];
-
-  if (!ch.notes[note].seen) {
-    ch.notes[note].seen = true;
-    ch.notes[note].active = false;
-    ch.seenNoteCount++;
-    recomputeLayout();
-  }
-}
-
-void setNoteActive(int channel, int note, bool active) {
-  if (channel < 0 || channel >= MAX_CHANNELS)
-    return;
-  if (note < 0 || note >= MAX_NOTES)
-    return;
-
-  channels[channel].notes[note].active = active;
-  // Trigger recompute (though strictly only needed if 'seen' changed, keeping
-  // it simple)
-  recomputeLayout();
-}
+#include "layout.h"
+#include "bsp.h"
+#include "hotpath.h"
+#include <cstdio>
+#include <string.h>
+
+// ============================================================================
+// Global State
+// ============================================================================
+
+ChannelEntry channels[MAX_CHANNELS];
+int activeChannelCount = 0;
+
+// Note tables come from a pool; a channel keeps its slot until it is
+// removed or layout_reset() runs
+static NoteEntry noteSlots[CHANNEL_SLOTS][MAX_NOTES];
+static bool slotUsed[CHANNEL_SLOTS];
+
+// Persistent tilings: channels over the wall, and each channel's notes
+// inside its bounds (one tree per note table slot)
+static_assert(MAX_CHANNELS <= 128 && MAX_NOTES <= 128,
+              "BSP items are 7-bit");
+static_assert(WALL_WIDTH * LAYOUT_ONE <= (bsp_coord_t)~0 &&
+                  WALL_HEIGHT * LAYOUT_ONE <= (bsp_coord_t)~0,
+              "Wall does not fit the BSP coordinates");
+static BspNode channelNodes[MAX_CHANNELS - 1];
+static uint8_t channelLeafParent[MAX_CHANNELS];
+static BspTree channelTree;
+
+static BspNode noteNodes[CHANNEL_SLOTS][MAX_NOTES - 1];
+static uint8_t noteLeafParent[CHANNEL_SLOTS][MAX_NOTES];
+static BspTree noteTrees[CHANNEL_SLOTS];
+
+// Bounding box of tiles changed since the last layout_takeDamage()
+static Rect damage;
+static bool damaged = false;
+
+// ============================================================================
+// Color Palette
+// ============================================================================
+
+//// original colors
+// static const uint32_t CHANNEL_COLORS[16] = {
+//     0xFF0000, // ch 0  Red
+//     0xFF8000, // ch 1  Orange
+//     0xFFFF00, // ch 2  Yellow
+//     0x80FF00, // ch 3  Chartreuse
+//     0x00FF00, // ch 4  Green
+//     0x00FF80, // ch 5  Spring Green
+//     0x00FFFF, // ch 6  Cyan
+//     0x0080FF, // ch 7  Azure
+//     0x0000FF, // ch 8  Blue
+//     0x8000FF, // ch 9  Violet
+//     0xFF00FF, // ch 10 Magenta
+//     0xFF0080, // ch 11 Rose
+//     0x8B4513, // ch 12 SaddleBrown
+//     0x008080, // ch 13 Teal
+//     0x800080, // ch 14 Purple
+//     0x708090, // ch 15 SlateGray
+// };
+
+//// Colors tuned to match my LEDs
+static const uint32_t HOT_DATA CHANNEL_COLORS[16] = {
+    0xFF7A00, // ch 1  Amber
+
+    0xFF6BFF, // ch 2  Light pinkish purple (requested)
+
+    0x0037FF, // ch 3  Strong blue (requested)
+
+    0xFFFF00, // ch 4  Yellow
+
+    0x00B84A, // ch 5  Slightly blueish green (requested)
+
+    0xFF00FF, // ch 6  Magenta (requested)
+
+    0xFF0000, // ch 7  Strong red (requested)
+
+    0x00E6FF, // ch 8  Cyan
+
+    0x6A00FF, // ch 9  Violet
+
+    0x73FF00, // ch10  Chartreuse
+
+    0xFF2E73, // ch11  Rose
+
+    0x0073FF, // ch12  Azure
+
+    0x00FF00, // ch13  Pure green
+
+    0xFF7300, // ch14  Orange
+
+    0x006060, // ch15  Teal
+
+    0x9A9A9A, // ch16  Light gray
+};
+
+// Color for a logical channel. The second port's bank starts half way round
+// the table so the same MIDI channel on both ports gets different colors.
+static uint32_t channelColor(int channel) {
+  return CHANNEL_COLORS[(channel + (channel / 16) * 8) % 16];
+}
+
+// Give a channel a note table from the pool. Returns false if none is left.
+static bool HOT_FUNC(attachNotes)(ChannelEntry &ch) {
+  if (ch.notes)
+    return true;
+  for (int s = 0; s < CHANNEL_SLOTS; s++) {
+    if (!slotUsed[s]) {
+      slotUsed[s] = true;
+      ch.slot = s;
+      ch.notes = noteSlots[s];
+      memset(ch.notes, 0, sizeof(noteSlots[0]));
+      bsp_clear(&noteTrees[s], ch.bounds);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void detachNotes(ChannelEntry &ch) {
+  if (!ch.notes)
+    return;
+  slotUsed[ch.slot] = false;
+  ch.slot = -1;
+  ch.notes = nullptr;
+}
+
+static void HOT_FUNC(addDamage)(Rect r) {
+  if (r.w <= 0 || r.h <= 0)
+    return;
+  if (!damaged) {
+    damage = r;
+    damaged = true;
+    return;
+  }
+  int x0 = r.x < damage.x ? r.x : damage.x;
+  int y0 = r.y < damage.y ? r.y : damage.y;
+  int x1 = r.x + r.w > damage.x + damage.w ? r.x + r.w : damage.x + damage.w;
+  int y1 = r.y + r.h > damage.y + damage.h ? r.y + r.h : damage.y + damage.h;
+  damage = {x0, y0, x1 - x0, y1 - y0};
+}
+
+static bool sameRect(const Rect &a, const Rect &b) {
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// ============================================================================
+// Incremental Binary Space Partitioning (BSP)
+// ============================================================================
+
+// A new channel or note joins the group of the largest existing tile, so
+// every other tile stays put. When a channel tile moves, only its own notes are
+// retiled (inside the new bounds, keeping their tree shape).
+static void HOT_FUNC(fitNotes)() {
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    ChannelEntry &ch = channels[c];
+    if (!ch.seen || !ch.notes)
+      continue;
+    BspTree &t = noteTrees[ch.slot];
+    if (!sameRect(t.area, ch.bounds))
+      bsp_setArea(&t, ch.bounds);
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void layout_init() { layout_reset(); }
+
+void layout_reset() {
+  memset(channels, 0, sizeof(channels));
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    channels[c].slot = -1;
+  }
+  memset(slotUsed, 0, sizeof(slotUsed));
+  activeChannelCount = 0;
+
+  bsp_init(&channelTree, channelNodes, channelLeafParent, MAX_CHANNELS,
+           &channels[0].bounds, sizeof(ChannelEntry));
+  bsp_setArea(&channelTree,
+              Rect{0, 0, WALL_WIDTH * LAYOUT_ONE, WALL_HEIGHT * LAYOUT_ONE});
+  for (int s = 0; s < CHANNEL_SLOTS; s++) {
+    bsp_init(&noteTrees[s], noteNodes[s], noteLeafParent[s], MAX_NOTES,
+             &noteSlots[s][0].bounds, sizeof(NoteEntry));
+  }
+  damaged = false;
+  addDamage(Rect{0, 0, WALL_WIDTH * LAYOUT_ONE, WALL_HEIGHT * LAYOUT_ONE});
+  printf("Layout Reset!\n");
+}
+
+void HOT_FUNC(registerChannel)(int channel) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+
+  ChannelEntry &ch = channels[channel];
+  if (!ch.seen) {
+    if (!attachNotes(ch)) {
+      printf("Layout: no note table for channel %d\n", channel + 1);
+      return;
+    }
+    ch.seen = true;
+    ch.color = channelColor(channel);
+    ch.seenNoteCount = 0;
+    activeChannelCount++;
+
+    Rect d;
+    bsp_insert(&channelTree, channel, &d);
+    addDamage(d);
+    fitNotes();
+    printf("Layout: channel %d at %d,%d %dx%d\n", channel + 1,
+           ch.bounds.x / LAYOUT_ONE, ch.bounds.y / LAYOUT_ONE,
+           ch.bounds.w / LAYOUT_ONE, ch.bounds.h / LAYOUT_ONE);
+  }
+}
+
+void HOT_FUNC(registerNote)(int channel, int note) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+  if (note < 0 || note >= MAX_NOTES)
+    return;
+
+  ChannelEntry &ch = channels[channel];
+  if (!ch.notes)
+    return;
+
+  if (!ch.notes[note].seen) {
+    ch.notes[note].seen = true;
+    ch.notes[note].active = false;
+    ch.seenNoteCount++;
+
+    Rect d;
+    bsp_insert(&noteTrees[ch.slot], note, &d);
+    addDamage(d);
+  }
+}
+
+void HOT_FUNC(setNoteActive)(int channel, int note, bool active) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+  if (note < 0 || note >= MAX_NOTES)
+    return;
+
+  if (!channels[channel].notes)
+    return; // Never seen, so nothing is lit
+
+  channels[channel].notes[note].active = active;
+}
+
+void layout_removeChannel(int channel) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+
+  ChannelEntry &ch = channels[channel];
+  if (!ch.seen)
+    return;
+
+  // Followers place channels with layout_setChannel(), outside the tree
+  Rect d;
+  if (bsp_remove(&channelTree, channel, &d)) {
+    addDamage(d);
+  } else {
+    addDamage(ch.bounds);
+    ch.bounds = Rect{0, 0, 0, 0};
+  }
+  detachNotes(ch);
+  ch.seen = false;
+  ch.seenNoteCount = 0;
+  activeChannelCount--;
+  fitNotes();
+}
+
+bool layout_takeDamage(Rect *out) {
+  if (!damaged)
+    return false;
+  *out = damage;
+  damaged = false;
+  return true;
+}
+
+void layout_setChannel(int channel, uint32_t color, Rect bounds) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+
+  ChannelEntry &ch = channels[channel];
+  if (!attachNotes(ch))
+    return;
+  if (!ch.seen) {
+    ch.seen = true;
+    activeChannelCount++;
+  }
+  ch.color = color;
+  if (!sameRect(ch.bounds, bounds)) {
+    addDamage(ch.bounds);
+    addDamage(bounds);
+    ch.bounds = bounds;
+  }
+}
+
+void layout_setNote(int channel, int note, Rect bounds) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+  if (note < 0 || note >= MAX_NOTES)
+    return;
+
+  // The channel's CHANNEL message was lost; the refresh sends both again
+  ChannelEntry &ch = channels[channel];
+  if (!ch.seen)
+    return;
+  if (!ch.notes[note].seen) {
+    ch.notes[note].seen = true;
+    ch.seenNoteCount++;
+  }
+  if (!sameRect(ch.notes[note].bounds, bounds)) {
+    addDamage(ch.notes[note].bounds);
+    addDamage(bounds);
+    ch.notes[note].bounds = bounds;
+  }
+}
+
+void layout_setActiveNotes(int channel, const uint8_t *bitmap) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+
+  if (!channels[channel].notes)
+    return;
+
+  for (int n = 0; n < MAX_NOTES; n++) {
+    channels[channel].notes[n].active = (bitmap[n >> 3] >> (n & 7)) & 1;
+  }
+}
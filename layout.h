@@ -1,62 +1,86 @@
-#ifndef LAYOUT_H
-#define LAYOUT_H
-
-#include "config.h"
-#include <stdint.h>
-
-// ============================================================================
-// Data Structures
-// ============================================================================
-
-// 2D Rectangle for layout
-typedef struct {
-  int x;
-  int y;
-  int w;
-  int h;
-} Rect;
-
-struct NoteEntry {
-  bool seen;   // Has this note ever fired on this channel?
-  bool active; // Is a note-on currently held?
-  Rect bounds; // 2D Bounds
-};
-
-struct ChannelEntry {
-  bool seen;         // Has this channel been detected?
-  uint32_t color;    // GRB color assigned at first detection
-  Rect bounds;       // 2D Bounds
-  int seenNoteCount; // How many distinct notes seen so far
-  NoteEntry notes[MAX_NOTES];
-};
-
-// ============================================================================
-// Global State
-// ============================================================================
-
-extern ChannelEntry channels[MAX_CHANNELS];
-extern int activeChannelCount;
-
-// ============================================================================
-// Public API
-// ============================================================================
-
-// Initialize layout engine (zero all state)
-void layout_init();
-
-// Reset all layout state (clear all channels/notes)
-void layout_reset();
-
-// Register a channel (if not already seen) and assign color
-void registerChannel(int channel);
-
-// Register a note on a channel (if not already seen)
-void registerNote(int channel, int note);
-
-// Set note active state (does not trigger reflow)
-void setNoteActive(int channel, int note, bool active);
-
-// Recompute all region boundaries (called after new channel/note detected)
-void recomputeLayout();
-
-#endif // LAYOUT_H
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "config.h"
+#include <stdint.h>
+
+// ============================================================================
+// Data Structures
+// ============================================================================
+
+// Layout coordinates are whole pixels, or 1/256 pixel with LAYOUT_SUBPIXEL
+#if LAYOUT_SUBPIXEL
+#define LAYOUT_FRAC_BITS 8
+#else
+#define LAYOUT_FRAC_BITS 0
+#endif
+#define LAYOUT_ONE (1 << LAYOUT_FRAC_BITS)
+
+// 2D Rectangle for layout (in layout coordinates)
+typedef struct {
+  int x;
+  int y;
+  int w;
+  int h;
+} Rect;
+
+struct NoteEntry {
+  bool seen;   // Has this note ever fired on this channel?
+  bool active; // Is a note-on currently held?
+  Rect bounds; // 2D Bounds
+};
+
+struct ChannelEntry {
+  bool seen;         // Has this channel been detected?
+  uint32_t color;    // GRB color assigned at first detection
+  Rect bounds;       // 2D Bounds
+  int seenNoteCount; // How many distinct notes seen so far
+  int slot;          // Note table pool slot, -1 until the channel is seen
+  NoteEntry *notes;  // MAX_NOTES entries from the pool (null until seen)
+};
+
+// ============================================================================
+// Global State
+// ============================================================================
+
+extern ChannelEntry channels[MAX_CHANNELS];
+extern int activeChannelCount;
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+// Initialize layout engine (zero all state)
+void layout_init();
+
+// Reset all layout state (clear all channels/notes)
+void layout_reset();
+
+// Register a channel (if not already seen) and assign color. The new tile
+// is cut from the largest existing one's group (see bsp.h), and only that
+// group moves. Does nothing once all CHANNEL_SLOTS
+// note tables are in use.
+void registerChannel(int channel);
+
+// Register a note on a channel (if not already seen); only the note tiles
+// of the group it joins move
+void registerNote(int channel, int note);
+
+// Set note active state (does not trigger reflow)
+void setNoteActive(int channel, int note, bool active);
+
+// Forget a channel and release its note table. Its tile goes to the
+// neighbouring tiles it was split from; nothing else moves.
+void layout_removeChannel(int channel);
+
+// Bounding box of every tile that moved, appeared or vanished since the
+// last call. Returns false if nothing changed.
+bool layout_takeDamage(Rect *out);
+
+// Apply layout computed elsewhere (link followers). These never reflow.
+void layout_setChannel(int channel, uint32_t color, Rect bounds);
+void layout_setNote(int channel, int note, Rect bounds);
+// Set active flags for a channel's seen notes from a 128-bit bitmap
+void layout_setActiveNotes(int channel, const uint8_t *bitmap);
+
+#endif // LAYOUT_H
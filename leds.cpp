@@ -1,16 +1,84 @@
 #include "leds.h"
+#include "blend.h"
 #include "config.h"
+#include "hardware/clocks.h"
 #include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pio.h"
+#include "hotpath.h"
 #include "pico/stdlib.h"
+#include <string.h>
+#if LED_INDEXED_FRAMEBUFFER
+#include "hardware/interp.h"
+#endif
+#if LED_DRIVER == LED_DRIVER_APA102
+#include "apa102.pio.h"
+#else
 #include "ws2812.pio.h"
+#endif
 
-// Internal framebuffer: LED_COUNT LEDs × 4 bytes (GRB + padding)
-static uint32_t framebuffer[LED_COUNT];
+// Internal framebuffer: LED_COUNT LEDs, either 4 bytes each (GRB + padding)
+// or, in indexed mode, one palette index each
+static led_pixel_t framebuffer[LED_COUNT] __attribute__((aligned(4)));
 static PIO pio = pio0;
 static uint sm = 0;
 static int dma_chan;
 
+#if LED_DRIVER == LED_DRIVER_APA102
+// APA102/SK9822: 32-bit frames clocked at LED_CLOCK_HZ. A zero start frame
+// goes first; the end frame provides the extra clock edges (one per two
+// LEDs) that push the last pixels down the chain. Nothing to wait for after.
+static const uint32_t BIT_HZ = LED_CLOCK_HZ;
+static const uint32_t BITS_PER_LED = 32;
+static const uint32_t LATCH_US = 0;
+static const int HEADER_WORDS = 1;
+static const int TRAILER_WORDS = 1 + (LED_COUNT + 63) / 64;
+#else
+// WS2812 timing: 24 bits (32 for RGBW) at 800 kHz, and the chain latches
+// after the line has been held low for >280 us
+static const uint32_t BIT_HZ = 800000;
+static const uint32_t BITS_PER_LED =
+    LED_DRIVER == LED_DRIVER_WS2812_RGBW ? 32 : 24;
+static const uint32_t LATCH_US = 300;
+static const int HEADER_WORDS = 0;
+static const int TRAILER_WORDS = 0;
+#endif
+static const uint32_t NS_PER_LED =
+    (uint32_t)(BITS_PER_LED * 1000000000ull / BIT_HZ);
+// Words still queued in the joined TX FIFO (8) plus the OSR when DMA finishes
+static const uint32_t FIFO_DRAIN_US = (9 * NS_PER_LED + 999) / 1000;
+
+// Transfer state, updated from the DMA completion IRQ
+static volatile bool transferring = false;
+static volatile bool latching = false;
+static volatile uint32_t show_start_us = 0;
+static volatile uint32_t latch_done_us = 0;
+static volatile uint32_t last_transfer_us = 0;
+
+// Palette: source colors, and the same colors in wire format with
+// global_brightness applied (rebuilt when the brightness changes)
+static uint32_t paletteRgb[256];
+static uint32_t paletteWire[256];
+static uint8_t paletteBrightness = 0;
+
+// Pixels are encoded at output time when the framebuffer does not already
+// hold wire words (indexed pixels, RGBW and APA102 strips): the DMA streams
+// from two small chunk buffers while the completion IRQ encodes the next
+// pixels into the one that just drained. Plain WS2812 sends the framebuffer
+// as is.
+#define CHUNKED_OUTPUT                                                         \
+  (LED_INDEXED_FRAMEBUFFER || LED_DRIVER != LED_DRIVER_WS2812)
+
+#if CHUNKED_OUTPUT
+static const int CHUNK_PIXELS = 64;
+// With room for the start frame before the first pixel and the end frame
+// after the last
+static uint32_t chunkBuf[2][HEADER_WORDS + CHUNK_PIXELS + TRAILER_WORDS];
+static volatile int chunkLen[2];
+static volatile int sendingChunk = 0;
+static volatile int nextPixel = 0;
+#endif
+
 // Global brightness
 uint8_t global_brightness = 128;
 
@@ -32,12 +100,13 @@ uint8_t global_brightness = 128;
 // and snake Left. Odd panels (1, 3, ...) start Top-Left and snake Right.
 // This allows for continuous data chaining (DO -> DI) between panels.
 
+static const int PANEL_H = 8; // Each physical panel is 8 pixels high
+
 static int xyToIndex(int x, int y) {
   if (x < 0 || x >= PANEL_WIDTH || y < 0 || y >= PANEL_HEIGHT) {
     return -1;
   }
 
-  const int PANEL_H = 8; // Each physical panel is 8 pixels high
   int panel_idx = y / PANEL_H;
   int local_y = y % PANEL_H;
   int panel_base = panel_idx * (PANEL_WIDTH * PANEL_H);
@@ -61,17 +130,214 @@ static int xyToIndex(int x, int y) {
   }
 }
 
+// ============================================================================
+// Strip Backends
+// ============================================================================
+
+// Packed pixel (0xGGRRBB00) -> the strip's word, shifted out MSB first
+static inline uint32_t encodePixel(uint32_t p) {
+#if LED_DRIVER == LED_DRIVER_APA102
+  // 111 + 5-bit global brightness (kept at full, the RGB is already scaled),
+  // then B, G, R
+  uint32_t g = p >> 24, r = (p >> 16) & 0xFF, b = (p >> 8) & 0xFF;
+  return 0xFF000000u | (b << 16) | (g << 8) | r;
+#elif LED_DRIVER == LED_DRIVER_WS2812_RGBW
+  // G, R, B, W with the white LED taking over the common part
+  uint32_t g = p >> 24, r = (p >> 16) & 0xFF, b = (p >> 8) & 0xFF;
+  uint32_t w = r < g ? r : g;
+  if (b < w)
+    w = b;
+  return ((g - w) << 24) | ((r - w) << 16) | ((b - w) << 8) | w;
+#else
+  return p;
+#endif
+}
+
+static void initBackend() {
+#if LED_DRIVER == LED_DRIVER_APA102
+  uint offset = pio_add_program(pio, &apa102_program);
+  apa102_program_init(pio, sm, offset, LED_PIN, LED_CLK_PIN, BIT_HZ);
+#else
+  uint offset = pio_add_program(pio, &ws2812_program);
+  ws2812_program_init(pio, sm, offset, LED_PIN, BIT_HZ,
+                      LED_DRIVER == LED_DRIVER_WS2812_RGBW);
+#endif
+}
+
+// PIO cycles per bit on the wire
+static int cyclesPerBit() {
+#if LED_DRIVER == LED_DRIVER_APA102
+  return 2;
+#else
+  return ws2812_T1 + ws2812_T2 + ws2812_T3;
+#endif
+}
+
+// ============================================================================
+// DMA Completion
+// ============================================================================
+
+#if LED_INDEXED_FRAMEBUFFER
+// Expand 4-pixel words of palette indices through interp0: lane 0 yields
+// &paletteWire[byte 0] and lane 1 (fed from accumulator 0) &paletteWire[byte 1]
+// of whatever is loaded into the accumulator
+static void HOT_FUNC(expandPixels)(const led_pixel_t *src, uint32_t *dst, int n) {
+  const uint32_t *words = (const uint32_t *)src;
+  for (int i = 0; i < n; i += 4) {
+    uint32_t w = *words++;
+    interp0->accum[0] = w << 2;
+    dst[i + 0] = *(const uint32_t *)interp0->peek[0];
+    dst[i + 1] = *(const uint32_t *)interp0->peek[1];
+    interp0->accum[0] = w >> 14;
+    dst[i + 2] = *(const uint32_t *)interp0->peek[0];
+    dst[i + 3] = *(const uint32_t *)interp0->peek[1];
+  }
+}
+
+static void initInterp() {
+  interp_config cfg = interp_default_config();
+  interp_config_set_shift(&cfg, 0);
+  interp_config_set_mask(&cfg, 2, 9);
+  interp_set_config(interp0, 0, &cfg);
+  interp_config_set_cross_input(&cfg, true);
+  interp_config_set_shift(&cfg, 8);
+  interp_set_config(interp0, 1, &cfg);
+  interp_set_base(interp0, 0, (uintptr_t)paletteWire);
+  interp_set_base(interp0, 1, (uintptr_t)paletteWire);
+}
+#endif
+
+#if CHUNKED_OUTPUT
+// Encode the next CHUNK_PIXELS pixels, framed by the strip's start and end
+// frames at either end of the chain
+static void HOT_FUNC(expandChunk)(int which) {
+  uint32_t *dst = chunkBuf[which];
+  int len = 0;
+  if (nextPixel == 0) {
+    for (int i = 0; i < HEADER_WORDS; i++)
+      dst[len++] = 0;
+  }
+
+  int n = LED_COUNT - nextPixel;
+  if (n > CHUNK_PIXELS)
+    n = CHUNK_PIXELS;
+#if LED_INDEXED_FRAMEBUFFER
+  expandPixels(&framebuffer[nextPixel], dst + len, n);
+#else
+  for (int i = 0; i < n; i++)
+    dst[len + i] = encodePixel(framebuffer[nextPixel + i]);
+#endif
+  len += n;
+  nextPixel += n;
+
+  if (n > 0 && nextPixel == LED_COUNT) {
+    for (int i = 0; i < TRAILER_WORDS; i++)
+      dst[len++] = 0;
+  }
+  chunkLen[which] = len;
+}
+#endif
+
+static void __isr HOT_FUNC(ledsDmaHandler)() {
+  dma_channel_acknowledge_irq0(dma_chan);
+
+#if CHUNKED_OUTPUT
+  // Keep the PIO fed from the other chunk, then refill the drained one
+  int done = sendingChunk;
+  int other = done ^ 1;
+  if (chunkLen[other] > 0) {
+    sendingChunk = other;
+    dma_channel_transfer_from_buffer_now(dma_chan, chunkBuf[other],
+                                         chunkLen[other]);
+    chunkLen[done] = 0;
+    if (nextPixel < LED_COUNT)
+      expandChunk(done);
+    return;
+  }
+  chunkLen[done] = 0;
+#endif
+
+  uint32_t now = time_us_32();
+  last_transfer_us = now - show_start_us;
+  latch_done_us = now + FIFO_DRAIN_US + LATCH_US;
+  latching = true;
+  transferring = false;
+}
+
+// ============================================================================
+// Color Conversion
+// ============================================================================
+
+// 0x00RRGGBB -> brightness-scaled packed GRB pixel (0xGGRRBB00), the
+// framebuffer format the blend kernels work on
+static uint32_t toPacked(uint32_t rgb) {
+  uint8_t r = (rgb >> 16) & 0xFF;
+  uint8_t g = (rgb >> 8) & 0xFF;
+  uint8_t b = rgb & 0xFF;
+
+  // Scale by brightness
+  r = (r * global_brightness) >> 8;
+  g = (g * global_brightness) >> 8;
+  b = (b * global_brightness) >> 8;
+
+  // Convert to GRB for WS2812 (0x00GGRRBB)
+  uint32_t grb = ((uint32_t)g << 16) | ((uint32_t)r << 8) | b;
+  return grb << 8;
+}
+
+// What the framebuffer stores for a color: the packed pixel, or in indexed
+// mode the palette holds the strip's encoded word for the DMA
+static uint32_t toWire(uint32_t rgb) {
+#if LED_INDEXED_FRAMEBUFFER
+  return encodePixel(toPacked(rgb));
+#else
+  return toPacked(rgb);
+#endif
+}
+
+// Brightness only touches the 256 palette entries, never the framebuffer
+static void refreshPalette() {
+  if (paletteBrightness == global_brightness)
+    return;
+  paletteBrightness = global_brightness;
+  for (int i = 0; i < 256; i++) {
+    paletteWire[i] = toWire(paletteRgb[i]);
+  }
+}
+
+// Fixed 6x6x6 color cube used for arbitrary colors in indexed mode
+static void initPalette() {
+  for (int i = 0; i < 216; i++) {
+    uint32_t r = (i / 36) * 51;
+    uint32_t g = ((i / 6) % 6) * 51;
+    uint32_t b = (i % 6) * 51;
+    paletteRgb[PALETTE_CUBE_BASE + i] = (r << 16) | (g << 8) | b;
+  }
+  paletteBrightness = ~global_brightness;
+  refreshPalette();
+}
+
+#if LED_INDEXED_FRAMEBUFFER
+static uint8_t nearestCubeIndex(uint32_t rgb) {
+  uint32_t r = (((rgb >> 16) & 0xFF) * 5 + 127) / 255;
+  uint32_t g = (((rgb >> 8) & 0xFF) * 5 + 127) / 255;
+  uint32_t b = ((rgb & 0xFF) * 5 + 127) / 255;
+  return (uint8_t)(PALETTE_CUBE_BASE + r * 36 + g * 6 + b);
+}
+#endif
+
 // ... Public API ...
 
 void leds_init() {
   // Clear framebuffer
-  for (int i = 0; i < LED_COUNT; i++) {
-    framebuffer[i] = 0;
-  }
+  memset(framebuffer, 0, sizeof(framebuffer));
+  initPalette();
+#if LED_INDEXED_FRAMEBUFFER
+  initInterp();
+#endif
 
-  // Load WS2812 PIO program
-  uint offset = pio_add_program(pio, &ws2812_program);
-  ws2812_program_init(pio, sm, offset, LED_PIN, 800000, false);
+  // Load the strip's PIO program
+  initBackend();
 
   // Set up DMA channel for efficient transfers
   dma_chan = dma_claim_unused_channel(true);
@@ -87,41 +353,235 @@ void leds_init() {
                         LED_COUNT,     // Transfer count
                         false          // Don't start yet
   );
+
+  // Completion IRQ lets leds_show() return immediately
+  dma_channel_set_irq0_enabled(dma_chan, true);
+  irq_set_exclusive_handler(DMA_IRQ_0, ledsDmaHandler);
+  irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void leds_reclock() {
+  pio_sm_set_clkdiv(pio, sm,
+                    (float)clock_get_hz(clk_sys) / (BIT_HZ * cyclesPerBit()));
 }
 
 void leds_setPixel(int x, int y, uint32_t rgb) {
   // Input RGB: 0x00RRGGBB
   int idx = xyToIndex(x, y);
   if (idx >= 0 && idx < LED_COUNT) {
-    uint8_t r = (rgb >> 16) & 0xFF;
-    uint8_t g = (rgb >> 8) & 0xFF;
-    uint8_t b = rgb & 0xFF;
+#if LED_INDEXED_FRAMEBUFFER
+    framebuffer[idx] = nearestCubeIndex(rgb);
+#else
+    framebuffer[idx] = toWire(rgb);
+#endif
+  }
+}
+
+void leds_setPaletteColor(uint8_t index, uint32_t rgb) {
+  paletteRgb[index] = rgb;
+  paletteWire[index] = toWire(rgb);
+}
+
+void leds_setPixelIndex(int x, int y, uint8_t index) {
+  int idx = xyToIndex(x, y);
+  if (idx >= 0 && idx < LED_COUNT) {
+#if LED_INDEXED_FRAMEBUFFER
+    framebuffer[idx] = index;
+#else
+    framebuffer[idx] = paletteWire[index];
+#endif
+  }
+}
+
+// Fill n consecutive framebuffer entries with a palette color
+static inline void fillRun(int start, int n, uint8_t index) {
+#if LED_INDEXED_FRAMEBUFFER
+  memset(&framebuffer[start], index, n);
+#else
+  blend_fill(&framebuffer[start], n, paletteWire[index]);
+#endif
+}
+
+void HOT_FUNC(leds_fillRect)(int x, int y, int w, int h, uint8_t index) {
+  // Clip to the display
+  int x0 = x < 0 ? 0 : x;
+  int x1 = x + w > PANEL_WIDTH ? PANEL_WIDTH : x + w;
+  int y0 = y < 0 ? 0 : y;
+  int y1 = y + h > PANEL_HEIGHT ? PANEL_HEIGHT : y + h;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  for (int panel = y0 / PANEL_H; panel * PANEL_H < y1; panel++) {
+    int top = panel * PANEL_H;
+    int ly0 = y0 > top ? y0 - top : 0;
+    int ly1 = y1 < top + PANEL_H ? y1 - top : PANEL_H;
+    int panel_base = top * PANEL_WIDTH;
+
+    // Columns in wiring order (see xyToIndex)
+    int c0 = x0, c1 = x1;
+    if (panel % 2 == 0) {
+      c0 = PANEL_WIDTH - x1;
+      c1 = PANEL_WIDTH - x0;
+    }
+
+    // Whole columns follow each other in the chain: a single run
+    if (ly0 == 0 && ly1 == PANEL_H) {
+      fillRun(panel_base + c0 * PANEL_H, (c1 - c0) * PANEL_H, index);
+      continue;
+    }
+
+    // Otherwise one run per column, running down or up
+    for (int col = c0; col < c1; col++) {
+      int base = panel_base + col * PANEL_H;
+      int start = (col % 2 == 0) ? base + ly0 : base + (PANEL_H - ly1);
+      fillRun(start, ly1 - ly0, index);
+    }
+  }
+}
 
-    // Scale by brightness
-    r = (r * global_brightness) >> 8;
-    g = (g * global_brightness) >> 8;
-    b = (b * global_brightness) >> 8;
+// Sub-pixel rects are 8.8 fixed point
+static const int FRAC_BITS = 8;
+static const int FRAC_ONE = 1 << FRAC_BITS;
+
+// How much of pixel p (0..FRAC_ONE) the span [a, b) covers
+static inline int spanCoverage(int p, int a, int b) {
+  int lo = p << FRAC_BITS;
+  int hi = lo + FRAC_ONE;
+  if (a > lo)
+    lo = a;
+  if (b < hi)
+    hi = b;
+  return hi > lo ? hi - lo : 0;
+}
+
+// Add a palette color scaled by coverage (0..256) to one pixel
+static void addCoverage(int x, int y, uint8_t index, uint32_t coverage) {
+  int idx = xyToIndex(x, y);
+  if (idx < 0)
+    return;
+#if LED_INDEXED_FRAMEBUFFER
+  // No room for partial colors here: snap the sum to the color cube
+  uint32_t rgb = blend_addSatPixel(paletteRgb[framebuffer[idx]],
+                                   blend_scalePixel(paletteRgb[index], coverage));
+  framebuffer[idx] = nearestCubeIndex(rgb);
+#else
+  framebuffer[idx] = blend_addSatPixel(
+      framebuffer[idx], blend_scalePixel(paletteWire[index], coverage));
+#endif
+}
 
-    // Convert to GRB for WS2812 (0x00GGRRBB)
-    uint32_t grb = ((uint32_t)g << 16) | ((uint32_t)r << 8) | b;
-    framebuffer[idx] = grb << 8;
+void HOT_FUNC(leds_fillRectFixed)(int x, int y, int w, int h, uint8_t index,
+                                  uint32_t level, uint32_t minCoverage) {
+  int xe = x + w;
+  int ye = y + h;
+
+  // Fully covered pixels at full level: the plain run fill
+  int ix0 = (x + FRAC_ONE - 1) >> FRAC_BITS, ix1 = xe >> FRAC_BITS;
+  int iy0 = (y + FRAC_ONE - 1) >> FRAC_BITS, iy1 = ye >> FRAC_BITS;
+  bool inner = level >= FRAC_ONE && ix1 > ix0 && iy1 > iy0;
+  if (inner)
+    leds_fillRect(ix0, iy0, ix1 - ix0, iy1 - iy0, index);
+
+  // The ring of partly covered pixels around them
+  int px0 = x >> FRAC_BITS, px1 = (xe + FRAC_ONE - 1) >> FRAC_BITS;
+  int py0 = y >> FRAC_BITS, py1 = (ye + FRAC_ONE - 1) >> FRAC_BITS;
+  if (px0 < 0)
+    px0 = 0;
+  if (px1 > PANEL_WIDTH)
+    px1 = PANEL_WIDTH;
+  if (py0 < 0)
+    py0 = 0;
+  if (py1 > PANEL_HEIGHT)
+    py1 = PANEL_HEIGHT;
+
+  for (int py = py0; py < py1; py++) {
+    int cy = spanCoverage(py, y, ye);
+    bool innerRow = inner && py >= iy0 && py < iy1;
+    for (int px = px0; px < px1; px++) {
+      if (innerRow && px >= ix0 && px < ix1) {
+        px = ix1 - 1; // Already filled
+        continue;
+      }
+      uint32_t coverage = (uint32_t)(spanCoverage(px, x, xe) * cy) >> FRAC_BITS;
+      if (coverage == 0)
+        continue;
+      coverage = (coverage * level) >> FRAC_BITS;
+      if (coverage < minCoverage)
+        coverage = minCoverage;
+      addCoverage(px, py, index, coverage);
+    }
   }
 }
 
-void leds_show() {
-  // Trigger DMA transfer
+void HOT_FUNC(leds_show)() {
+  leds_waitIdle();
+
+  // Trigger DMA transfer; completion is picked up by ledsDmaHandler()
+  show_start_us = time_us_32();
+  transferring = true;
+#if CHUNKED_OUTPUT
+  // Prime both chunks before starting so the IRQ is the only expander
+  nextPixel = 0;
+  expandChunk(0);
+  expandChunk(1);
+  sendingChunk = 0;
+  dma_channel_transfer_from_buffer_now(dma_chan, chunkBuf[0], chunkLen[0]);
+#else
   dma_channel_set_read_addr(dma_chan, framebuffer, true);
+#endif
+}
 
-  // Wait for transfer to complete
-  dma_channel_wait_for_finish_blocking(dma_chan);
+bool HOT_FUNC(leds_busy)() {
+  if (transferring) {
+    return true;
+  }
+  if (latching && (int32_t)(time_us_32() - latch_done_us) < 0) {
+    return true;
+  }
+  latching = false;
+  return false;
+}
+
+void leds_waitIdle() {
+  while (leds_busy()) {
+    tight_loop_contents();
+  }
+}
+
+uint32_t leds_frameTimeUs() {
+  uint32_t transfer = last_transfer_us;
+  if (transfer == 0) {
+    transfer = (uint32_t)((LED_COUNT + HEADER_WORDS + TRAILER_WORDS) *
+                          (uint64_t)NS_PER_LED / 1000);
+  }
+  return transfer + FIFO_DRAIN_US + LATCH_US;
 }
 
-void leds_clear() {
-  for (int i = 0; i < LED_COUNT; i++) {
-    framebuffer[i] = 0;
+led_pixel_t *leds_framebuffer() { return framebuffer; }
+
+void leds_readFrame(uint32_t *rgb) {
+  for (int y = 0; y < PANEL_HEIGHT; y++) {
+    for (int x = 0; x < PANEL_WIDTH; x++) {
+#if LED_INDEXED_FRAMEBUFFER
+      uint32_t p = toPacked(paletteRgb[framebuffer[xyToIndex(x, y)]]);
+#else
+      uint32_t p = framebuffer[xyToIndex(x, y)];
+#endif
+      // Packed 0xGGRRBB00 -> 0x00RRGGBB
+      *rgb++ = (p & 0x00FF0000u) | ((p >> 16) & 0xFF00u) | ((p >> 8) & 0xFFu);
+    }
   }
 }
 
+void HOT_FUNC(leds_clear)() {
+  refreshPalette();
+#if LED_INDEXED_FRAMEBUFFER
+  memset(framebuffer, 0, sizeof(framebuffer));
+#else
+  blend_fill(framebuffer, LED_COUNT, 0);
+#endif
+}
+
 void leds_startup_sequence() {
   // Debug Sequence: Red -> Green -> Blue -> Cyan
   uint32_t colors[] = {0xFF0000, 0x00FF00, 0x0000FF, 0x00FFFF};
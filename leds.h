@@ -1,18 +1,72 @@
 #ifndef LEDS_H
 #define LEDS_H
 
+#include "config.h"
 #include <stdint.h>
 
+// One framebuffer entry: a wire-format GRB word, or a palette index when
+// LED_INDEXED_FRAMEBUFFER is set
+#if LED_INDEXED_FRAMEBUFFER
+typedef uint8_t led_pixel_t;
+#else
+typedef uint32_t led_pixel_t;
+#endif
+
 // Initialize the LED driver (PIO + DMA)
 void leds_init();
 
+// Recompute the PIO bit timing after clk_sys has changed
+void leds_reclock();
+
 // Set a single pixel color at logical (x, y) coordinates
 // Color format: 0x00GGRRBB (24-bit GRB for WS2812B)
+// In indexed mode the color is snapped to the built-in color cube
 void leds_setPixel(int x, int y, uint32_t grb);
 
-// Flush the framebuffer to the LED chain via DMA
+// Set palette entry 'index' (0 is black). Brightness is applied when the
+// palette is expanded, so entries take plain 0x00RRGGBB colors.
+void leds_setPaletteColor(uint8_t index, uint32_t rgb);
+
+// Set a pixel to a palette entry (a single table lookup, no color math)
+void leds_setPixelIndex(int x, int y, uint8_t index);
+
+// Fill a rectangle with a palette entry, clipped to the display. The rect is
+// split into contiguous runs of the column-serpentine chain (one per column,
+// or one per panel when it spans whole columns) and filled with word stores.
+void leds_fillRect(int x, int y, int w, int h, uint8_t index);
+
+// Fill a rectangle given in 1/256 pixel units (8.8 fixed point) at
+// brightness level/256. At full level the whole pixels inside go through
+// leds_fillRect(). Other pixels get the color scaled by level and their
+// coverage, but at least minCoverage/256, added to what is already there, so
+// tiles that share a pixel add up to the full color. In indexed mode those
+// pixels are snapped to the color cube.
+void leds_fillRectFixed(int x, int y, int w, int h, uint8_t index,
+                        uint32_t level, uint32_t minCoverage);
+
+// Start flushing the framebuffer to the LED chain via DMA (non-blocking).
+// Waits for the previous frame to latch first.
 void leds_show();
 
+// True while a frame is being clocked out or the chain is latching
+bool leds_busy();
+
+// Block until the last frame has been transmitted and latched.
+// Call before writing into the framebuffer to avoid tearing.
+void leds_waitIdle();
+
+// Time needed to present one frame (transfer + FIFO drain + latch), in us.
+// Measured from the last transfer; estimated from LED_COUNT before that.
+uint32_t leds_frameTimeUs();
+
+// Direct access to the wire-ordered framebuffer (LED_COUNT entries). In
+// direct mode these are packed GRB pixels for the kernels in blend.h.
+led_pixel_t *leds_framebuffer();
+
+// Copy the frame as shown (brightness applied) into rgb: LED_COUNT 0x00RRGGBB
+// pixels in row-major logical order
+void leds_readFrame(uint32_t *rgb);
+
 // Clear all pixels to black (does not auto-flush)
 void leds_clear();
 
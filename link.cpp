@@ -0,0 +1,154 @@
+#include "link.h"
+#include "config.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+#include "layout.h"
+#include "linkproto.h"
+#include "linksync.h"
+#include "pico/stdlib.h"
+#include <cstdio>
+
+static_assert(WALL_WIDTH * LAYOUT_ONE < (1 << (2 * LINK_RECT_BYTES)) &&
+                  WALL_HEIGHT * LAYOUT_ONE < (1 << (2 * LINK_RECT_BYTES)),
+              "Wall does not fit the link rect coordinates");
+
+// The SPI peripheral only receives as a slave with clk_peri >= 12 x SCK, and
+// power_init() drops clk_peri to the USB PLL for idle power-down
+#if ENABLE_IDLE_POWERDOWN
+static_assert(LINK_BAUD * 12ull <= USB_CLK_HZ,
+              "LINK_BAUD too fast for followers with ENABLE_IDLE_POWERDOWN");
+#else
+static_assert(LINK_BAUD * 12ull <= SYS_CLK_HZ,
+              "LINK_BAUD too fast for followers");
+#endif
+
+// ============================================================================
+// Master
+// ============================================================================
+
+#if LINK_ROLE == LINK_ROLE_MASTER
+
+static const int TX_BUFFER_SIZE = 2048;
+
+static uint8_t txBuf[TX_BUFFER_SIZE];
+static int txDma = -1;
+
+void link_init() {
+  spi_init(LINK_SPI, LINK_BAUD);
+  spi_set_format(LINK_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+  gpio_set_function(LINK_SCK_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(LINK_CS_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(LINK_TX_PIN, GPIO_FUNC_SPI);
+
+  txDma = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(txDma);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, spi_get_dreq(LINK_SPI, true));
+  dma_channel_configure(txDma, &c, &spi_get_hw(LINK_SPI)->dr, txBuf, 0,
+                        false);
+
+  printf("Link: master, %d boards\n", LINK_NODE_COUNT);
+}
+
+void link_masterReset() { linksync_masterReset(); }
+
+void link_masterFrame(uint8_t mode, uint32_t level, uint32_t fade_us) {
+  // The previous frame is normally long gone (a full buffer takes ~4 ms at
+  // 4 MHz); txBuf must not be refilled while it is still going out
+  dma_channel_wait_for_finish_blocking(txDma);
+  while (spi_is_busy(LINK_SPI)) {
+    tight_loop_contents();
+  }
+
+  // Nothing is wired to our RX; drain it and clear the overrun flag
+  while (spi_is_readable(LINK_SPI)) {
+    (void)spi_get_hw(LINK_SPI)->dr;
+  }
+  spi_get_hw(LINK_SPI)->icr = SPI_SSPICR_RORIC_BITS;
+
+  int len = linksync_masterFrame(txBuf, TX_BUFFER_SIZE, global_brightness,
+                                 mode, level, fade_us);
+  dma_channel_transfer_from_buffer_now(txDma, txBuf, len);
+}
+
+void link_followerPoll() {}
+
+// ============================================================================
+// Follower
+// ============================================================================
+
+#elif LINK_ROLE == LINK_ROLE_FOLLOWER
+
+// The RX DMA writes into this ring forever; its write pointer is the head
+static const int RX_RING_BITS = 12;
+static const uint32_t RX_RING_SIZE = 1u << RX_RING_BITS;
+static uint8_t rxRing[RX_RING_SIZE] __attribute__((aligned(RX_RING_SIZE)));
+static uint32_t rxTail = 0;
+static int rxDma = -1;
+
+static LinkDecoder decoder;
+
+void link_init() {
+  spi_init(LINK_SPI, LINK_BAUD);
+  spi_set_slave(LINK_SPI, true);
+  spi_set_format(LINK_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+  gpio_set_function(LINK_SCK_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(LINK_CS_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(LINK_RX_PIN, GPIO_FUNC_SPI);
+
+  linkproto_initDecoder(&decoder);
+
+  rxDma = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(rxDma);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, RX_RING_BITS);
+  channel_config_set_dreq(&c, spi_get_dreq(LINK_SPI, false));
+  dma_channel_configure(rxDma, &c, rxRing, &spi_get_hw(LINK_SPI)->dr,
+                        DMA_CH0_TRANS_COUNT_MODE_VALUE_ENDLESS
+                            << DMA_CH0_TRANS_COUNT_MODE_LSB,
+                        true);
+
+  printf("Link: follower %d of %d\n", LINK_NODE_INDEX, LINK_NODE_COUNT);
+}
+
+void link_masterReset() {}
+
+void link_masterFrame(uint8_t mode, uint32_t level, uint32_t fade_us) {
+  (void)mode;
+  (void)level;
+  (void)fade_us;
+}
+
+void link_followerPoll() {
+  uint32_t head =
+      (dma_channel_hw_addr(rxDma)->write_addr - (uintptr_t)rxRing) &
+      (RX_RING_SIZE - 1);
+  while (rxTail != head) {
+    uint8_t b = rxRing[rxTail];
+    rxTail = (rxTail + 1) & (RX_RING_SIZE - 1);
+    if (linkproto_feed(&decoder, b))
+      linksync_apply(decoder.pkt);
+  }
+}
+
+// ============================================================================
+// Standalone
+// ============================================================================
+
+#else
+
+void link_init() {}
+void link_masterReset() {}
+void link_masterFrame(uint8_t mode, uint32_t level, uint32_t fade_us) {
+  (void)mode;
+  (void)level;
+  (void)fade_us;
+}
+void link_followerPoll() {}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+
+// Multi-board display link (see linkproto.h for the wire format).
+// Everything here is a no-op unless LINK_ROLE is set in config.h.
+
+// Initialize SPI and DMA for the configured role
+void link_init();
+
+// Master: followers must drop their state (call after layout_reset())
+void link_masterReset();
+
+// Master: send the layout/note deltas for this frame followed by PRESENT
+// (see linksync.h). Starts the DMA and returns; only if the previous frame
+// is still going out does it wait for that first. A frame is usually a
+// few packets (tens of microseconds on the wire), so PRESENT reaches the
+// followers while the master is still rendering its own slice. mode is the
+// visualization every board draws (main.cpp's VisMode).
+void link_masterFrame(uint8_t mode, uint32_t level, uint32_t fade_us);
+
+// Follower: decode received packets and apply them to the layout
+void link_followerPoll();
+
+// Callback implemented by main.cpp (followers): render and show the frame
+extern void onLinkPresent(uint8_t brightness, uint8_t mode, uint32_t level,
+                          uint32_t fade_us);
+
+#endif // LINK_H
@@ -0,0 +1,162 @@
+#include "linkproto.h"
+
+// Decoder states
+enum { WAIT_SYNC, WAIT_TYPE, WAIT_LEN, WAIT_PAYLOAD, WAIT_CHECKSUM };
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+int linkproto_encode(uint8_t type, const uint8_t *payload, uint8_t len,
+                     uint8_t *out, int cap) {
+  int total = len + 4;
+  if (len > LINK_MAX_PAYLOAD || total > cap)
+    return 0;
+
+  uint8_t sum = type + len;
+  out[0] = LINK_SYNC;
+  out[1] = type;
+  out[2] = len;
+  for (int i = 0; i < len; i++) {
+    out[3 + i] = payload[i];
+    sum += payload[i];
+  }
+  out[3 + len] = (uint8_t)~sum;
+  return total;
+}
+
+#if LAYOUT_SUBPIXEL
+static void packRect(uint8_t *p, const Rect &r) {
+  const int v[4] = {r.x, r.y, r.w, r.h};
+  for (int i = 0; i < 4; i++) {
+    p[2 * i] = v[i] & 0xFF;
+    p[2 * i + 1] = (v[i] >> 8) & 0xFF;
+  }
+}
+
+Rect linkproto_rect(const uint8_t *p) {
+  return Rect{p[0] | (p[1] << 8), p[2] | (p[3] << 8), p[4] | (p[5] << 8),
+              p[6] | (p[7] << 8)};
+}
+#else
+static void packRect(uint8_t *p, const Rect &r) {
+  p[0] = (uint8_t)r.x;
+  p[1] = (uint8_t)r.y;
+  p[2] = (uint8_t)r.w;
+  p[3] = (uint8_t)r.h;
+}
+
+Rect linkproto_rect(const uint8_t *p) { return Rect{p[0], p[1], p[2], p[3]}; }
+#endif
+
+uint8_t linkproto_packChannel(uint8_t *payload, uint8_t ch, const Rect &r,
+                              uint32_t color) {
+  payload[0] = ch;
+  packRect(&payload[1], r);
+  uint8_t *rgb = &payload[1 + LINK_RECT_BYTES];
+  rgb[0] = (color >> 16) & 0xFF;
+  rgb[1] = (color >> 8) & 0xFF;
+  rgb[2] = color & 0xFF;
+  return LINK_CHANNEL_LEN;
+}
+
+uint8_t linkproto_packNote(uint8_t *payload, uint8_t ch, uint8_t note,
+                           const Rect &r) {
+  payload[0] = ch;
+  payload[1] = note;
+  packRect(&payload[2], r);
+  return LINK_NOTE_LEN;
+}
+
+uint8_t linkproto_packPresent(uint8_t *payload, uint8_t seq,
+                              uint8_t brightness, uint8_t mode, uint16_t level,
+                              uint16_t fade_ms) {
+  payload[0] = seq;
+  payload[1] = brightness;
+  payload[2] = level & 0xFF;
+  payload[3] = level >> 8;
+  payload[4] = fade_ms & 0xFF;
+  payload[5] = fade_ms >> 8;
+  payload[6] = mode;
+  return LINK_PRESENT_LEN;
+}
+
+uint8_t linkproto_packMpe(uint8_t *payload, uint8_t ch,
+                          const MpeChannelState &s) {
+  payload[0] = ch;
+  payload[1] = s.manager;
+  payload[2] = s.isManager;
+  payload[3] = s.note;
+  payload[4] = s.pressure;
+  payload[5] = (uint16_t)s.bend & 0xFF;
+  payload[6] = (uint16_t)s.bend >> 8;
+  payload[7] = s.bendRange;
+  payload[8] = s.managerBendRange;
+  return LINK_MPE_LEN;
+}
+
+MpeChannelState linkproto_mpe(const uint8_t *p) {
+  return MpeChannelState{p[0],
+                         p[1] != 0,
+                         p[2],
+                         p[3],
+                         (int16_t)(p[4] | (p[5] << 8)),
+                         p[6],
+                         p[7]};
+}
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+void linkproto_initDecoder(LinkDecoder *d) {
+  d->state = WAIT_SYNC;
+  d->pos = 0;
+  d->sum = 0;
+  d->errors = 0;
+}
+
+bool linkproto_feed(LinkDecoder *d, uint8_t b) {
+  switch (d->state) {
+  case WAIT_SYNC:
+    if (b == LINK_SYNC)
+      d->state = WAIT_TYPE;
+    return false;
+
+  case WAIT_TYPE:
+    if (b == LINK_SYNC) // Never a valid type: treat as a fresh sync
+      return false;
+    d->pkt.type = b;
+    d->sum = b;
+    d->state = WAIT_LEN;
+    return false;
+
+  case WAIT_LEN:
+    if (b > LINK_MAX_PAYLOAD) {
+      d->errors++;
+      d->state = WAIT_SYNC;
+      return false;
+    }
+    d->pkt.len = b;
+    d->sum += b;
+    d->pos = 0;
+    d->state = (b == 0) ? WAIT_CHECKSUM : WAIT_PAYLOAD;
+    return false;
+
+  case WAIT_PAYLOAD:
+    d->pkt.payload[d->pos++] = b;
+    d->sum += b;
+    if (d->pos == d->pkt.len)
+      d->state = WAIT_CHECKSUM;
+    return false;
+
+  case WAIT_CHECKSUM:
+  default:
+    d->state = WAIT_SYNC;
+    if ((uint8_t)~d->sum != b) {
+      d->errors++;
+      return false;
+    }
+    return true;
+  }
+}
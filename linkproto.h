@@ -0,0 +1,84 @@
+#ifndef LINKPROTO_H
+#define LINKPROTO_H
+
+#include "layout.h"
+#include "mpe.h"
+#include <stdint.h>
+
+// Master/follower display link protocol.
+//
+// The master board owns MIDI parsing and layout; it streams layout deltas and
+// note-state bitmaps to follower boards, then a PRESENT marker at which every
+// board shows the same frame. This module is framing and message packing
+// only (no hardware), so it runs unchanged in a host build.
+//
+// Packet: SYNC, type, len, payload[len], checksum
+// checksum = ~(type + len + sum(payload)) & 0xFF
+
+#define LINK_SYNC 0xA5
+#define LINK_MAX_PAYLOAD 32
+
+// Rect coordinates are single bytes, or 16-bit little endian when the
+// layout is in sub-pixel units (LAYOUT_SUBPIXEL)
+#if LAYOUT_SUBPIXEL
+#define LINK_RECT_BYTES 8
+#else
+#define LINK_RECT_BYTES 4
+#endif
+#define LINK_CHANNEL_LEN (1 + LINK_RECT_BYTES + 3)
+#define LINK_NOTE_LEN (2 + LINK_RECT_BYTES)
+#define LINK_MPE_LEN 9
+#define LINK_PRESENT_LEN 7
+
+enum LinkMsgType : uint8_t {
+  LINK_MSG_RESET = 0x01,   // (none)            forget all channels/notes
+  LINK_MSG_CHANNEL = 0x02, // ch rect r g b     channel color and bounds
+  LINK_MSG_NOTE = 0x03,    // ch note rect      note bounds (marks it seen)
+  LINK_MSG_NOTES = 0x04,   // ch bitmap[16]     active notes, bit n = note n
+  LINK_MSG_PRESENT = 0x05, // seq bright level(2) fade_ms(2) mode  show it
+  LINK_MSG_REMOVE = 0x06,  // ch                forget channel and its notes
+  LINK_MSG_MPE = 0x07,     // ch manager isManager note pressure bend(2)
+                           //    bendRange managerBendRange  MPE state
+};
+
+struct LinkPacket {
+  uint8_t type;
+  uint8_t len;
+  uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+struct LinkDecoder {
+  uint8_t state;
+  uint8_t pos;
+  uint8_t sum;
+  LinkPacket pkt;
+  uint32_t errors; // Checksum failures / oversize packets (resyncs)
+};
+
+// Frame a packet into out. Returns bytes written, or 0 if it does not fit.
+int linkproto_encode(uint8_t type, const uint8_t *payload, uint8_t len,
+                     uint8_t *out, int cap);
+
+// Message builders (payload only; pass the result to linkproto_encode)
+uint8_t linkproto_packChannel(uint8_t *payload, uint8_t ch, const Rect &r,
+                              uint32_t color);
+uint8_t linkproto_packNote(uint8_t *payload, uint8_t ch, uint8_t note,
+                           const Rect &r);
+uint8_t linkproto_packPresent(uint8_t *payload, uint8_t seq,
+                              uint8_t brightness, uint8_t mode, uint16_t level,
+                              uint16_t fade_ms);
+uint8_t linkproto_packMpe(uint8_t *payload, uint8_t ch,
+                          const MpeChannelState &s);
+
+// Unpack a rect stored as LINK_RECT_BYTES bytes at p
+Rect linkproto_rect(const uint8_t *p);
+
+// Unpack the MPE state of a LINK_MSG_MPE payload (after the channel)
+MpeChannelState linkproto_mpe(const uint8_t *p);
+
+// Byte-at-a-time decoder. Returns true when d->pkt holds a complete packet
+// with a valid checksum.
+void linkproto_initDecoder(LinkDecoder *d);
+bool linkproto_feed(LinkDecoder *d, uint8_t b);
+
+#endif // LINKPROTO_H
@@ -0,0 +1,268 @@
+#include "linksync.h"
+#include "config.h"
+#include "layout.h"
+#include "link.h"
+#include "mpe.h"
+#include <string.h>
+
+// ============================================================================
+// Master
+// ============================================================================
+
+#if LINK_ROLE == LINK_ROLE_MASTER
+
+static const int PRESENT_SIZE = 4 + LINK_PRESENT_LEN; // Kept free for PRESENT
+
+static uint8_t *txBuf = nullptr; // Frame being encoded
+static int txCap = 0;
+static int txLen = 0;
+static bool backlog = false;
+
+static uint8_t frameSeq = 0;
+static int refreshChannel = 0;
+static bool resetPending = true;
+
+// What the followers are known to hold. Anything that differs (or was never
+// sent) goes out on the next frame.
+static bool chanSent[MAX_CHANNELS];
+static uint8_t chanShadow[MAX_CHANNELS][LINK_CHANNEL_LEN];
+static uint8_t noteSent[MAX_CHANNELS][MAX_NOTES / 8];
+static uint8_t noteShadow[CHANNEL_SLOTS][MAX_NOTES][LINK_RECT_BYTES]; // By slot
+static bool activeSent[MAX_CHANNELS];
+static uint8_t activeShadow[MAX_CHANNELS][MAX_NOTES / 8];
+static bool mpeSent[MAX_CHANNELS];
+static uint8_t mpeShadow[MAX_CHANNELS][LINK_MPE_LEN];
+
+// Channels whose note rects may have moved (layout damage touched them)
+static bool notesDirty[MAX_CHANNELS];
+
+static bool emit(uint8_t type, const uint8_t *payload, uint8_t len) {
+  int n = linkproto_encode(type, payload, len, txBuf + txLen,
+                           txCap - PRESENT_SIZE - txLen);
+  txLen += n;
+  return n > 0;
+}
+
+static void forgetChannel(int c) {
+  chanSent[c] = false;
+  memset(noteSent[c], 0, sizeof(noteSent[c]));
+  activeSent[c] = false;
+  mpeSent[c] = false;
+  notesDirty[c] = true;
+}
+
+static bool overlaps(const Rect &a, const Rect &b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+         b.y < a.y + a.h;
+}
+
+// Queue whatever changed on channel c. Returns false once the buffer is
+// full; the rest is picked up on the next frame.
+static bool queueChannel(int c) {
+  ChannelEntry &ch = channels[c];
+  uint8_t payload[LINK_MAX_PAYLOAD];
+
+  uint8_t len = linkproto_packChannel(payload, c, ch.bounds, ch.color);
+  if (!chanSent[c] || memcmp(chanShadow[c], payload, len) != 0) {
+    if (!emit(LINK_MSG_CHANNEL, payload, len))
+      return false;
+    memcpy(chanShadow[c], payload, len);
+    chanSent[c] = true;
+  }
+
+  uint8_t bitmap[MAX_NOTES / 8] = {0};
+  for (int n = 0; n < MAX_NOTES; n++) {
+    NoteEntry &ne = ch.notes[n];
+    if (!ne.seen)
+      continue;
+    if (ne.active)
+      bitmap[n >> 3] |= 1u << (n & 7);
+
+    bool sent = (noteSent[c][n >> 3] >> (n & 7)) & 1;
+    if (sent && !notesDirty[c])
+      continue;
+    len = linkproto_packNote(payload, c, n, ne.bounds);
+    uint8_t *shadow = noteShadow[ch.slot][n];
+    if (!sent || memcmp(shadow, &payload[2], LINK_RECT_BYTES) != 0) {
+      if (!emit(LINK_MSG_NOTE, payload, len))
+        return false;
+      memcpy(shadow, &payload[2], LINK_RECT_BYTES);
+      noteSent[c][n >> 3] |= 1u << (n & 7);
+    }
+  }
+
+  if (!activeSent[c] || memcmp(activeShadow[c], bitmap, sizeof(bitmap)) != 0) {
+    payload[0] = c;
+    memcpy(&payload[1], bitmap, sizeof(bitmap));
+    if (!emit(LINK_MSG_NOTES, payload, 1 + sizeof(bitmap)))
+      return false;
+    memcpy(activeShadow[c], bitmap, sizeof(bitmap));
+    activeSent[c] = true;
+  }
+  notesDirty[c] = false;
+  return true;
+}
+
+// MPE expression is drawn on every board. Member channels have no tile of
+// their own, so this covers all channels, seen or not.
+static bool queueMpe(int c) {
+  MpeChannelState s;
+  mpe_getChannel(c, &s);
+  uint8_t payload[LINK_MPE_LEN];
+  uint8_t len = linkproto_packMpe(payload, c, s);
+  if (mpeSent[c] && memcmp(mpeShadow[c], payload, len) == 0)
+    return true;
+  if (!emit(LINK_MSG_MPE, payload, len))
+    return false;
+  memcpy(mpeShadow[c], payload, len);
+  mpeSent[c] = true;
+  return true;
+}
+
+// A channel the layout dropped: the followers release it too, then it is
+// no longer sent
+static bool retireChannel(int c) {
+  uint8_t payload[1] = {(uint8_t)c};
+  if (!emit(LINK_MSG_REMOVE, payload, 1))
+    return false;
+  forgetChannel(c);
+  return true;
+}
+
+void linksync_masterReset() { resetPending = true; }
+
+int linksync_masterFrame(uint8_t *out, int cap, uint8_t brightness,
+                         uint8_t mode, uint32_t level, uint32_t fade_us) {
+  txBuf = out;
+  txCap = cap;
+  txLen = 0;
+  backlog = false;
+
+  if (resetPending) {
+    emit(LINK_MSG_RESET, nullptr, 0);
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+      forgetChannel(c);
+    }
+    resetPending = false;
+  }
+
+  // Trickle a full resend so a follower that missed data (or booted late)
+  // converges. An unused channel gets a REMOVE, in case the follower still
+  // holds it.
+  if (frameSeq % LINK_REFRESH_FRAMES == 0) {
+    forgetChannel(refreshChannel);
+    if (!channels[refreshChannel].seen)
+      chanSent[refreshChannel] = true;
+    refreshChannel = (refreshChannel + 1) % MAX_CHANNELS;
+  }
+
+  // Only channels under the layout damage need their note rects diffed
+  Rect damage;
+  if (layout_takeDamage(&damage)) {
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+      if (channels[c].seen && overlaps(channels[c].bounds, damage))
+        notesDirty[c] = true;
+    }
+  }
+
+  // Retire dropped channels first: the channels replacing them need their
+  // note tables on the followers
+  for (int c = 0; c < MAX_CHANNELS && !backlog; c++) {
+    if (!channels[c].seen && chanSent[c] && !retireChannel(c))
+      backlog = true;
+  }
+  for (int c = 0; c < MAX_CHANNELS && !backlog; c++) {
+    if (channels[c].seen && !queueChannel(c))
+      backlog = true;
+  }
+#if ENABLE_MPE
+  for (int c = 0; c < MAX_CHANNELS && !backlog; c++) {
+    if (!queueMpe(c))
+      backlog = true;
+  }
+#endif
+
+  // PRESENT always fits: emit() keeps PRESENT_SIZE in reserve
+  uint8_t payload[LINK_MAX_PAYLOAD];
+  uint32_t fade_ms = fade_us / 1000;
+  uint8_t len = linkproto_packPresent(payload, frameSeq++, brightness, mode,
+                                      (uint16_t)level,
+                                      (uint16_t)(fade_ms > 0xFFFF ? 0xFFFF
+                                                                  : fade_ms));
+  txLen += linkproto_encode(LINK_MSG_PRESENT, payload, len, txBuf + txLen,
+                            txCap - txLen);
+  return txLen;
+}
+
+bool linksync_masterBacklog() { return backlog; }
+
+#else
+
+void linksync_masterReset() {}
+int linksync_masterFrame(uint8_t *out, int cap, uint8_t brightness,
+                         uint8_t mode, uint32_t level, uint32_t fade_us) {
+  (void)out;
+  (void)cap;
+  (void)brightness;
+  (void)mode;
+  (void)level;
+  (void)fade_us;
+  return 0;
+}
+bool linksync_masterBacklog() { return false; }
+
+#endif
+
+// ============================================================================
+// Follower
+// ============================================================================
+
+void linksync_apply(const LinkPacket &pkt) {
+  const uint8_t *p = pkt.payload;
+
+  switch (pkt.type) {
+  case LINK_MSG_RESET:
+    layout_reset();
+    break;
+
+  case LINK_MSG_CHANNEL:
+    if (pkt.len == LINK_CHANNEL_LEN) {
+      const uint8_t *rgb = &p[1 + LINK_RECT_BYTES];
+      uint32_t color =
+          ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+      layout_setChannel(p[0], color, linkproto_rect(&p[1]));
+    }
+    break;
+
+  case LINK_MSG_NOTE:
+    if (pkt.len == LINK_NOTE_LEN)
+      layout_setNote(p[0], p[1], linkproto_rect(&p[2]));
+    break;
+
+  case LINK_MSG_NOTES:
+    if (pkt.len == 1 + MAX_NOTES / 8)
+      layout_setActiveNotes(p[0], &p[1]);
+    break;
+
+  case LINK_MSG_REMOVE:
+    if (pkt.len == 1)
+      layout_removeChannel(p[0]);
+    break;
+
+  case LINK_MSG_MPE:
+    if (pkt.len == LINK_MPE_LEN)
+      mpe_setChannel(p[0], linkproto_mpe(&p[1]));
+    break;
+
+  case LINK_MSG_PRESENT:
+    if (pkt.len == LINK_PRESENT_LEN) {
+      uint32_t level = p[2] | (p[3] << 8);
+      uint32_t fade_ms = p[4] | (p[5] << 8);
+      onLinkPresent(p[1], p[6], level, fade_ms * 1000);
+    }
+    break;
+
+  default: // Unknown message from a newer master: skip
+    break;
+  }
+}
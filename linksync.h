@@ -0,0 +1,36 @@
+#ifndef LINKSYNC_H
+#define LINKSYNC_H
+
+#include "linkproto.h"
+#include <stdint.h>
+
+// Layout sync over the display link: which packets the master sends each
+// frame, and how a follower applies them. No hardware access; link.cpp only
+// moves the bytes, so tools/link_sim.cpp runs a master and several
+// followers in one host process.
+//
+// The master keeps a shadow of what the followers hold (layout and MPE
+// state) and sends only what differs, plus one channel's full state every
+// LINK_REFRESH_FRAMES frames (or a REMOVE if it is not in use). A follower
+// that joins late converges within one round of MAX_CHANNELS *
+// LINK_REFRESH_FRAMES frames. One that lost bytes may take two: a channel
+// it missed the REMOVE for can hold the last note table until its own
+// refresh.
+
+// Master: followers must drop their state (sent with the next frame)
+void linksync_masterReset();
+
+// Master: encode this frame's layout changes followed by PRESENT into out
+// and return the number of bytes. Changes that do not fit in cap go out on
+// the next frame; PRESENT always fits.
+int linksync_masterFrame(uint8_t *out, int cap, uint8_t brightness,
+                         uint8_t mode, uint32_t level, uint32_t fade_us);
+
+// Master: true if the last frame left changes for the next one
+bool linksync_masterBacklog();
+
+// Follower: apply one decoded packet to the layout. PRESENT calls
+// onLinkPresent() (link.h).
+void linksync_apply(const LinkPacket &pkt);
+
+#endif // LINKSYNC_H
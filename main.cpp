@@ -1,51 +1,159 @@
+#include "bench.h"
+#include "blend.h"
+#include "capture.h"
+#include "console.h"
 #include "config.h"
 #include "hardware/adc.h"
 #include "hardware/sync.h"
+#include "hotpath.h"
 #include "layout.h"
 #include "leds.h"
+#include "link.h"
 #include "midi.h"
+#include "midiclock.h"
+#include "mirror.h"
+#include "mpe.h"
+#include "pianoroll.h"
+#include "power.h"
 #include "pico/stdlib.h"
+#include "scheduler.h"
+#include "smfplayer.h"
+#include "telemetry.h"
 #include <cstdio>
 #include <cstdlib>
+#include <string.h>
+
+// Visualization modes, toggled with a long press of the reset button. Link
+// followers take the mode from the master's PRESENT.
+enum VisMode { VIS_LAYOUT, VIS_PIANO_ROLL };
+
+static VisMode visMode = VIS_LAYOUT;
 
 // ============================================================================
 // MIDI Callbacks
 // ============================================================================
 
-void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+static uint32_t eventsSinceFrame = 0; // Telemetry: note events per frame
+
+void HOT_FUNC(onNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity) {
   (void)velocity; // Not using velocity for brightness (future enhancement)
+  eventsSinceFrame++;
+  power_activity();
+
+  // MPE member channels draw on their zone manager's tile
+  int tile = mpe_noteOn(channel, note);
 
   // Register channel and note if first time seen
-  registerChannel(channel);
-  registerNote(channel, note);
+  registerChannel(tile);
+  registerNote(tile, note);
 
+#if MIDI_DEBUG_TRACE
   printf("NoteOn: Ch=%d Note=%d Vel=%d (Active Ch: %d)\n", channel, note,
-         velocity, activeChannelCount); // DEBUG
+         velocity, activeChannelCount);
+#endif
 
   // Set note active
-  setNoteActive(channel, note, true);
+  setNoteActive(tile, note, true);
+  roll_noteOn(tile, note);
 }
 
-void onNoteOff(uint8_t channel, uint8_t note) {
+void HOT_FUNC(onNoteOff)(uint8_t channel, uint8_t note) {
+  eventsSinceFrame++;
+  power_activity();
+
+  int tile;
+  if (!mpe_noteOff(channel, note, &tile))
+    return; // Another member channel still holds this note
+
   // Set note inactive (no need to register if not already seen)
-  if (channel < MAX_CHANNELS && note < MAX_NOTES) {
-    setNoteActive(channel, note, false);
+  if (tile < MAX_CHANNELS && note < MAX_NOTES) {
+    setNoteActive(tile, note, false);
   }
 }
 
+void onPitchBend(uint8_t channel, int16_t bend) {
+  power_activity(); // A held MPE note is still being played
+  mpe_pitchBend(channel, bend);
+}
+
+void onChannelPressure(uint8_t channel, uint8_t pressure) {
+  power_activity();
+  mpe_pressure(channel, pressure);
+}
+
+void onParameter(uint8_t channel, uint16_t rpn, uint8_t value) {
+  mpe_parameter(channel, rpn, value);
+}
+
 // ============================================================================
 // Render Loop
 // ============================================================================
 
-void render() {
-  leds_clear();
+// Scale a 0xRRGGBB color by level/256
+static uint32_t scaleColor(uint32_t rgb, uint32_t level) {
+  uint32_t r = (((rgb >> 16) & 0xFF) * level) >> 8;
+  uint32_t g = (((rgb >> 8) & 0xFF) * level) >> 8;
+  uint32_t b = ((rgb & 0xFF) * level) >> 8;
+  return (r << 16) | (g << 8) | b;
+}
+
+// Brightness envelope for the current frame: full on the beat, decaying
+// quadratically towards the next one. Phase comes from the filtered MIDI
+// clock, so the pulse stays aligned regardless of the frame interval.
+static uint32_t beatLevel(uint32_t now_us) {
+#if ENABLE_BEAT_PULSE
+  if (midiclock_running() && midiclock_locked(now_us)) {
+    uint32_t remaining = 65536 - midiclock_beatPhase(now_us); // 1..65536
+    uint32_t decay = (remaining >> 8) * (remaining >> 8) >> 8; // 0..256
+    return (256 - BEAT_PULSE_DEPTH) + ((BEAT_PULSE_DEPTH * decay) >> 8);
+  }
+#else
+  (void)now_us;
+#endif
+  return 256;
+}
+
+static_assert(PALETTE_CHANNEL_BASE + MAX_CHANNELS <= PALETTE_CUBE_BASE,
+              "Channel colors overlap the palette color cube");
+
+// Load this frame's channel colors into the palette. The beat pulse scales
+// the palette rather than every pixel.
+static void HOT_FUNC(updateChannelPalette)(uint32_t level) {
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    uint32_t color = channels[c].seen ? channels[c].color : 0;
+    if (level < 256)
+      color = scaleColor(color, level);
+    leds_setPaletteColor(PALETTE_CHANNEL_BASE + c, color);
+  }
+}
+
+// Rows of the wall layout driven by this board
+static const int SLICE_Y = LINK_NODE_INDEX * PANEL_HEIGHT;
 
+// MPE note: pitch bend slides the tile sideways (MPE_SEMITONES_PER_TILE
+// moves it by its own width, and it never goes further than that) and
+// pressure sets its brightness. Drawn in 8.8 whatever the layout resolution.
+static void HOT_FUNC(drawExpressive)(const Rect &r, int32_t bend,
+                                     uint32_t level, uint8_t color) {
+  const int scale = 256 / LAYOUT_ONE;
+  int w = r.w * scale;
+  int dx = w * bend / (256 * MPE_SEMITONES_PER_TILE);
+  if (dx > w)
+    dx = w;
+  if (dx < -w)
+    dx = -w;
+  leds_fillRectFixed(r.x * scale + dx, (r.y - SLICE_Y * LAYOUT_ONE) * scale,
+                     w, r.h * scale, color, level, LAYOUT_MIN_COVERAGE);
+}
+
+// Static tile map: each seen note owns a BSP region
+static void HOT_FUNC(renderLayout)() {
   // Iterate through all channels
   for (int c = 0; c < MAX_CHANNELS; c++) {
     if (!channels[c].seen)
       continue;
 
-    uint32_t color = channels[c].color;
+    uint8_t color = PALETTE_CHANNEL_BASE + c;
 
     // Iterate through all notes in this channel
     for (int n = 0; n < MAX_NOTES; n++) {
@@ -56,39 +164,277 @@ void render() {
         continue;
       }
 
-      // Light up 2D Rect regions which are now variable size
-      // Check for valid dimensions
-      if (ne.bounds.w == 0 || ne.bounds.h == 0)
+      int32_t bend;
+      uint32_t level;
+      if (mpe_expression(c, n, &bend, &level)) {
+        drawExpressive(ne.bounds, bend, level, color);
         continue;
-
-      for (int x = ne.bounds.x; x < ne.bounds.x + ne.bounds.w; x++) {
-        for (int y = ne.bounds.y; y < ne.bounds.y + ne.bounds.h; y++) {
-          leds_setPixel(x, y, color);
-        }
       }
+
+      // Bounds are in wall coordinates; fillRect clips to this board's slice
+#if LAYOUT_SUBPIXEL
+      leds_fillRectFixed(ne.bounds.x, ne.bounds.y - SLICE_Y * LAYOUT_ONE,
+                         ne.bounds.w, ne.bounds.h, color, 256,
+                         LAYOUT_MIN_COVERAGE);
+#else
+      leds_fillRect(ne.bounds.x, ne.bounds.y - SLICE_Y, ne.bounds.w,
+                    ne.bounds.h, color);
+#endif
     }
   }
+}
+
+// Afterglow fade time: half a beat while a MIDI clock is locked
+static uint32_t afterglowFadeUs(uint32_t now_us) {
+  uint32_t bpm = midiclock_bpmX100();
+  if (midiclock_locked(now_us) && bpm > 0) {
+    return 3000000000u / bpm; // Half a beat: 60e6 * 100 / bpm / 2
+  }
+  return AFTERGLOW_US;
+}
+
+#if ENABLE_AFTERGLOW
+// Previous composited frame, decayed each frame and kept under the notes
+static uint32_t trail[LED_COUNT];
+static uint32_t lastCompositeUs = 0;
+
+// Composite the afterglow layer under the freshly drawn note layer
+static void HOT_FUNC(compositeAfterglow)(uint32_t now_us, uint32_t fade_us) {
+  // Linear fade per frame; compounding over frames gives an exponential tail
+  uint32_t dt = now_us - lastCompositeUs;
+  lastCompositeUs = now_us;
+  uint32_t level = dt >= fade_us ? 0 : 256 - (uint32_t)(256ull * dt / fade_us);
+
+  uint32_t *fb = leds_framebuffer();
+  blend_scale(trail, LED_COUNT, level);
+  blend_max(fb, trail, LED_COUNT);
+  memcpy(trail, fb, sizeof(trail));
+}
+#endif
+
+// Draw and show one frame with the given beat level and afterglow fade
+static void HOT_FUNC(renderFrame)(uint32_t now, uint32_t level, uint32_t fade_us) {
+  (void)fade_us;
+
+  // Don't touch the framebuffer while the previous frame is still going out
+  leds_waitIdle();
+  uint32_t start = time_us_32();
+  leds_clear();
+
+  updateChannelPalette(level);
+  if (visMode == VIS_PIANO_ROLL) {
+    roll_update(now);
+    roll_render();
+  } else {
+    renderLayout();
+#if ENABLE_AFTERGLOW
+    compositeAfterglow(now, fade_us);
+#endif
+  }
+
+  uint32_t renderUs = time_us_32() - start;
+  telemetry.renderUs = renderUs;
+  if (renderUs > telemetry.renderMaxUs)
+    telemetry.renderMaxUs = renderUs;
+  telemetry.eventsPerFrame = eventsSinceFrame;
+  if (eventsSinceFrame > telemetry.eventsPerFrameMax)
+    telemetry.eventsPerFrameMax = eventsSinceFrame;
+  eventsSinceFrame = 0;
+  telemetry.transmitUs = leds_frameTimeUs();
+  telemetry.frames++;
+  mirror_frame();
 
+  // Kick the DMA; transmission overlaps with the other tasks
   leds_show();
 }
 
+void render() {
+  uint32_t now = time_us_32();
+  uint32_t level = visMode == VIS_LAYOUT ? beatLevel(now) : 256;
+  uint32_t fade_us = afterglowFadeUs(now);
+
+  // Followers show on PRESENT; it goes out while we render our own slice
+  link_masterFrame(visMode, level, fade_us);
+  renderFrame(now, level, fade_us);
+}
+
+#if ENABLE_IDLE_POWERDOWN && LINK_ROLE != LINK_ROLE_FOLLOWER
+// Last frame before power-down: everything (followers too) at level 0
+static void blackout() {
+  link_masterFrame(visMode, 0, 0);
+  renderFrame(time_us_32(), 0, 0);
+}
+#endif
+
+// Link followers: the master has sent a complete frame
+void onLinkPresent(uint8_t brightness, uint8_t mode, uint32_t level,
+                   uint32_t fade_us) {
+  global_brightness = brightness;
+  visMode = mode == VIS_PIANO_ROLL ? VIS_PIANO_ROLL : VIS_LAYOUT;
+  renderFrame(time_us_32(), level, fade_us);
+}
+
+// ============================================================================
+// Tasks
+// ============================================================================
+
+static int frameTask = -1;
+static uint64_t flashUntil = 0; // Reset-button flash holds the frame until
+static bool buttonHeld = false;
+static uint64_t buttonDownAt = 0;
+
+#ifdef PICO_DEFAULT_LED_PIN
+static const uint LED_PIN_ONBOARD = PICO_DEFAULT_LED_PIN;
+#endif
+
+static void frameTick(uint64_t now) {
+  if (now < flashUntil)
+    return;
+
+  render();
+
+  const Task *task = scheduler_getTask(frameTask);
+  telemetry.framesSkipped = task->skipped;
+  telemetry.frameOverruns = task->overruns;
+
+  // Track the real cost of pushing LED_COUNT pixels instead of a fixed 16 ms
+  uint32_t interval = leds_frameTimeUs() + FRAME_MARGIN_US;
+  if (interval < FRAME_MIN_INTERVAL_US)
+    interval = FRAME_MIN_INTERVAL_US;
+  scheduler_setPeriod(frameTask, interval);
+}
+
+static void midiTick(uint64_t now) {
+  (void)now;
+  midi_poll(); // Drain the UART FIFO
+}
+
+static void consoleTick(uint64_t now) {
+  (void)now;
+  console_poll();
+}
+
+static void mirrorTick(uint64_t now) {
+  (void)now;
+  mirror_service();
+}
+
+static void captureTick(uint64_t now) {
+  capture_service((uint32_t)now); // Flash spill during input gaps
+}
+
+#if ENABLE_SHOW && LINK_ROLE != LINK_ROLE_FOLLOWER
+static int showTask = -1;
+
+// Woken for the next show event, or every SHOW_INTERVAL_US to watch input
+static void showTick(uint64_t now) {
+  scheduler_wakeAt(showTask, smfplayer_service(now));
+}
+#endif
+
+#if LINK_ROLE == LINK_ROLE_FOLLOWER
+static void linkTick(uint64_t now) {
+  (void)now;
+  link_followerPoll();
+}
+#endif
+
+static void inputTick(uint64_t now) {
+#if ENABLE_POTENTIOMETER && LINK_ROLE != LINK_ROLE_FOLLOWER
+  uint16_t adc_val = adc_read();
+  global_brightness = adc_val >> 4; // Map 12-bit (0-4095) to 8-bit (0-255)
+#endif
+
+  // Poll Reset Button (Active Low). Sampling every INPUT_INTERVAL_US
+  // debounces it; the action fires on release.
+  bool pressed = !gpio_get(RESET_BTN_PIN);
+  if (pressed && !buttonHeld) {
+    printf("Reset Button Pressed!\n");
+    buttonDownAt = now;
+  } else if (!pressed && buttonHeld &&
+             now - buttonDownAt >= MODE_SWITCH_HOLD_MS * 1000ull) {
+    // Long press: switch visualization
+#if LINK_ROLE != LINK_ROLE_NONE
+    // The roll scrolls notes in per board, but followers only see the
+    // master's note state once a frame, so short notes would never reach
+    // them; keep linked panels on the layout
+    printf("Visualization: piano roll needs a single board\n");
+#else
+    visMode = (visMode == VIS_LAYOUT) ? VIS_PIANO_ROLL : VIS_LAYOUT;
+    printf("Visualization: %s\n",
+           visMode == VIS_LAYOUT ? "layout" : "piano roll");
+#endif
+  } else if (!pressed && buttonHeld) {
+    layout_reset();
+    roll_reset();
+    link_masterReset();
+
+    // Flash random colors
+    leds_waitIdle();
+    for (int y = 0; y < PANEL_HEIGHT; y++) {
+      for (int x = 0; x < PANEL_WIDTH; x++) {
+        uint32_t color =
+            ((rand() % 128) << 16) | ((rand() % 128) << 8) | (rand() % 128);
+        leds_setPixel(x, y, color);
+      }
+    }
+    leds_show();
+    flashUntil = now + RESET_BUTTON_FLASH_TIME * 1000ull; // Visual feedback
+  }
+  buttonHeld = pressed;
+}
+
+static void heartbeatTick(uint64_t now) {
+  (void)now;
+  // Heartbeat: Blink onboard LED
+#ifdef PICO_DEFAULT_LED_PIN
+  gpio_xor_mask(1u << LED_PIN_ONBOARD);
+#endif
+}
+
+static void telemetryTick(uint64_t now) {
+  telemetry_update((uint32_t)now);
+
+  // Only report when some task has blown its budget since the last report
+  static uint32_t lastOverruns = 0;
+  uint32_t overruns = telemetry.taskOverruns;
+  if (overruns != lastOverruns) {
+    printf("Scheduler overruns: %lu (frame %lu us)\n", (unsigned long)overruns,
+           (unsigned long)leds_frameTimeUs());
+    scheduler_printStats();
+    lastOverruns = overruns;
+  }
+}
+
 // ============================================================================
 // Main Entry Point
 // ============================================================================
 
 int main() {
+  power_init();
   stdio_init_all();
   printf("MidiLeds Booting...\n");
 
   // Initialize all subsystems
   leds_init();
   leds_startup_sequence();
+  blend_bench();
   midi_init();
+  link_init();
+  capture_init();
+  telemetry_init();
+  bench_init();
+  mirror_init();
+#if LINK_ROLE != LINK_ROLE_FOLLOWER
+  smfplayer_init();
+#endif
   layout_init();
+  mpe_init(); // After the layout: preset zones drop member channel tiles
+  roll_init();
+  scheduler_init();
 
 // Initialize onboard LED for heartbeat (best effort)
 #ifdef PICO_DEFAULT_LED_PIN
-  const uint LED_PIN_ONBOARD = PICO_DEFAULT_LED_PIN;
   gpio_init(LED_PIN_ONBOARD);
   gpio_set_dir(LED_PIN_ONBOARD, GPIO_OUT);
 #endif
@@ -105,59 +451,36 @@ int main() {
   printf("Potentiometer Enabled on Pin %d (ADC %d)\n", POT_PIN, POT_ADC_NUM);
 #endif
 
-  // Main render loop
-  while (true) {
-    // Limit frame rate to ~60 FPS (16ms)
-    // WS2812B timing is sensitive; flooding it might cause issues
-    static uint32_t last_frame = 0;
-    uint32_t now = to_ms_since_boot(get_absolute_time());
-    if (now - last_frame >= 16) {
-#if ENABLE_POTENTIOMETER
-      uint16_t adc_val = adc_read();
-      global_brightness = adc_val >> 4; // Map 12-bit (0-4095) to 8-bit (0-255)
+  // Tasks: name, body, priority (lower first), period, budget (all in us)
+#if LINK_ROLE == LINK_ROLE_FOLLOWER
+  // Frames are paced by the master's PRESENT packets
+  scheduler_addTask("link", linkTick, 0, LINK_POLL_INTERVAL_US, 1000);
+#else
+  scheduler_addTask("midi", midiTick, 0, MIDI_DRAIN_INTERVAL_US, 200);
+  frameTask = scheduler_addTask("frame", frameTick, 1, leds_frameTimeUs(), 1000);
+  scheduler_addTask("capture", captureTick, 2, CAPTURE_INTERVAL_US, 1000);
+#if ENABLE_SHOW
+  showTask = scheduler_addTask("show", showTick, 1, SHOW_INTERVAL_US, 1000);
 #endif
-
-      // Critical Section: Disable interrupts during transmission to prevent
-      // timing glitches
-      uint32_t irq_status = save_and_disable_interrupts();
-      render();
-      restore_interrupts(irq_status);
-      last_frame = now;
-    }
-
-    midi_poll(); // Poll as fast as possible to drain FIFO
-
-    // Heartbeat: Blink onboard LED every 500ms
-#ifdef PICO_DEFAULT_LED_PIN
-    static uint32_t last_blink = 0;
-    if (to_ms_since_boot(get_absolute_time()) - last_blink > 500) {
-      gpio_xor_mask(1u << LED_PIN_ONBOARD);
-      last_blink = to_ms_since_boot(get_absolute_time());
-    }
 #endif
+  scheduler_addTask("input", inputTick, 2, INPUT_INTERVAL_US, 100);
+  scheduler_addTask("console", consoleTick, 3, CONSOLE_INTERVAL_US, 500);
+  scheduler_addTask("mirror", mirrorTick, 3, MIRROR_INTERVAL_US, 500);
+  scheduler_addTask("heartbeat", heartbeatTick, 3, HEARTBEAT_INTERVAL_US, 20);
+  scheduler_addTask("telemetry", telemetryTick, 4, TELEMETRY_INTERVAL_US, 5000);
 
-    // Poll Reset Button (Active Low)
-    if (!gpio_get(RESET_BTN_PIN)) {
-      printf("Reset Button Pressed!\n");
-      // Debounce: Wait for release
-      while (!gpio_get(RESET_BTN_PIN)) {
-        sleep_ms(10);
-      }
-      layout_reset();
-      
-      // Flash random colors
-      for (int y = 0; y < PANEL_HEIGHT; y++) {
-        for (int x = 0; x < PANEL_WIDTH; x++) {
-          uint32_t color = ((rand() % 128) << 16) | ((rand() % 128) << 8) | (rand() % 128);
-          leds_setPixel(x, y, color);
-        }
-      }
-      leds_show();
-      sleep_ms(RESET_BUTTON_FLASH_TIME); // Visual feedback
+  // Main loop: dispatch tasks by deadline, sleeping in between
+  while (true) {
+    scheduler_runOnce();
 
-      leds_clear();
-      leds_show();
+#if ENABLE_IDLE_POWERDOWN && LINK_ROLE != LINK_ROLE_FOLLOWER
+    // Followers stay up: they are woken by the master's frames, not by MIDI
+    if (power_idleDue(time_us_64())) {
+      blackout();
+      power_sleep();
+      scheduler_resume(); // Drain MIDI and draw the next frame right away
     }
+#endif
   }
 
   return 0;
@@ -1,176 +1,117 @@
 #include "midi.h"
+#include "capture.h"
 #include "config.h"
+#include "hardware/irq.h"
 #include "hardware/uart.h"
-#include "layout.h"
+#include "hotpath.h"
+#include "midiclock.h"
+#include "midiparser.h"
+#include "midithru.h"
 #include "pico/stdlib.h"
-
-extern int activeChannelCount; // From layout.cpp
+#include "smfplayer.h"
+#include "telemetry.h"
 #include <cstdio>
 
-// MIDI parser state machine
-enum MidiState { WAITING_STATUS, WAITING_DATA1, WAITING_DATA2 };
-
-static MidiState state = WAITING_STATUS;
-static uint8_t runningStatus = 0;
-static uint8_t currentStatus = 0;
-static uint8_t data1 = 0;
-static bool inSysEx = false;
-
-// ============================================================================
-// Helper Functions
-// ============================================================================
+// Receive ring, filled by the UART RX interrupt. Each byte carries the time
+// it arrived so clock ticks are not skewed by how late the main loop drains.
+struct RxEntry {
+  uint32_t t_us;
+  uint8_t b;
+  bool gap; // Input was lost right before this byte
+};
 
-static inline bool isStatusByte(uint8_t b) { return (b & 0x80) != 0; }
+// One DIN input: UART, receive ring and parser
+struct MidiPort {
+  uart_inst_t *uart;
+  RxEntry ring[MIDI_RX_RING_SIZE];
+  volatile uint32_t head; // Written by the IRQ
+  volatile uint32_t tail; // Written by midi_poll()
+  bool gap;               // IRQ: bytes lost since the last queued one
+  MidiParser parser;
+};
 
-static inline bool isDataByte(uint8_t b) { return (b & 0x80) == 0; }
+static MidiPort ports[MIDI_PORTS];
 
-static inline uint8_t getMessageType(uint8_t status) { return status & 0xF0; }
-
-static inline uint8_t getChannel(uint8_t status) { return status & 0x0F; }
+static_assert(MIDI_PORTS <= TELEMETRY_PORTS, "Telemetry has no slot for port");
 
 // ============================================================================
-// Message Handlers
+// UART Receive Interrupt
 // ============================================================================
 
-static void handleNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
-  (void)velocity; // Unused
-  onNoteOff(channel, note);
-}
-
-static void handleNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
-  if (velocity == 0) {
-    // Note On with velocity 0 is treated as Note Off
-    onNoteOff(channel, note);
-  } else {
-    onNoteOn(channel, note, velocity);
-  }
-}
-
-static void handleControlChange(uint8_t channel, uint8_t controller,
-                                uint8_t value) {
-  (void)value; // Unused
-
-  // All Notes Off (CC 123 / 0x7B)
-  if (controller == 0x7B) {
-    // Fire note-off for all 128 possible notes on this channel
-    for (int note = 0; note < 128; note++) {
-      onNoteOff(channel, note);
-    }
-  }
-  // All other CCs are ignored
-}
-
-// ============================================================================
-// State Machine
-// ============================================================================
-
-static void processByte(uint8_t b) {
-  // DEBUG: Simple parser trace
-  if (b < 0xF8) { // Ignore clock
-    printf("Parser[%d] Byte: %02X\n", state, b);
-  }
-  // Handle SysEx mode
-  if (inSysEx) {
-    if (b == 0xF7) {
-      inSysEx = false; // End of SysEx
-    }
-    return; // Consume all SysEx bytes
-  }
-
-  // Check for new status byte
-  if (isStatusByte(b)) {
-    if (b == 0xF0) {
-      // Start of SysEx
-      inSysEx = true;
-      runningStatus = 0; // Clear running status
-      return;
+static inline void receive(int index) {
+  MidiPort &port = ports[index];
+  TelemetryPort &stats = telemetry.ports[index];
+  uart_hw_t *hw = uart_get_hw(port.uart);
+  uint32_t now = time_us_32();
+
+  while (!(hw->fr & UART_UARTFR_RXFE_BITS)) {
+    // Error flags arrive alongside each byte (same bits as UARTRSR)
+    uint32_t dr = hw->dr;
+    uint8_t b = (uint8_t)dr;
+    stats.rxBytes++;
+    if (dr & UART_UARTDR_OE_BITS) {
+      stats.overrunErrors++; // Bytes before this one were lost
+      port.gap = true;
     }
-
-    if (b >= 0xF8) {
-      // Real-time messages (ignore)
-      return;
+    if (dr & UART_UARTDR_BE_BITS) {
+      stats.breakErrors++;
+      continue;
     }
-
-    if (b >= 0xF0) {
-      // System Common messages (ignore, clear running status)
-      runningStatus = 0;
-      return;
+    if (dr & UART_UARTDR_FE_BITS) {
+      stats.framingErrors++;
+      continue;
     }
 
-    // Channel voice message
-    currentStatus = b;
-    runningStatus = b;
-    state = WAITING_DATA1;
-    // printf("State -> WAITING_DATA1\n");
-    return;
-  }
-
-  // Data byte handling
-  if (!isDataByte(b)) {
-    return; // Invalid byte, ignore
-  }
-
-  switch (state) {
-  case WAITING_STATUS: {
-    // Unexpected data byte - use running status if available
-    if (runningStatus != 0) {
-      currentStatus = runningStatus;
-      data1 = b;
-
-      uint8_t msgType = getMessageType(currentStatus);
-      if (msgType == 0xC0 || msgType == 0xD0) {
-        // Program Change and Channel Pressure have only 1 data byte
-        state = WAITING_STATUS;
-      } else {
-        state = WAITING_DATA2;
-      }
+    midithru_input(index, b); // Forward before anything else for low latency
+    uint32_t head = port.head;
+    if (head - port.tail >= MIDI_RX_RING_SIZE) {
+      stats.ringDrops++; // Ring full: main loop has stalled for too long
+      port.gap = true;
+      continue;
     }
-    break;
+    port.ring[head % MIDI_RX_RING_SIZE] = {now, b, port.gap};
+    port.head = head + 1;
+    port.gap = false;
   }
+}
 
-  case WAITING_DATA1: {
-    data1 = b;
+static void __isr HOT_FUNC(midiUartIrq)() { receive(0); }
 
-    uint8_t msgType = getMessageType(currentStatus);
-    if (msgType == 0xC0 || msgType == 0xD0) {
-      // Program Change and Channel Pressure have only 1 data byte
-      state = WAITING_STATUS;
-    } else {
-      state = WAITING_DATA2;
-    }
-    break;
-  }
+#if MIDI_PORTS > 1
+static void __isr HOT_FUNC(midiUart2Irq)() { receive(1); }
+#endif
 
-  case WAITING_DATA2: {
-    uint8_t data2 = b;
-    uint8_t channel = getChannel(currentStatus);
-    uint8_t msgType = getMessageType(currentStatus);
-
-    // Dispatch message
-    printf("Dispatch! Ch:%d Msg:%02X D1:%02X D2:%02X\n", channel, msgType,
-           data1, data2);
-    switch (msgType) {
-    case 0x80: // Note Off
-      handleNoteOff(channel, data1, data2);
-      break;
-
-    case 0x90: // Note On
-      handleNoteOn(channel, data1, data2);
-      break;
-
-    case 0xB0: // Control Change
-      handleControlChange(channel, data1, data2);
-      break;
-
-    // All other message types are silently ignored
-    default:
-      break;
-    }
+// ============================================================================
+// Helper Functions
+// ============================================================================
 
-    state = WAITING_STATUS;
-    break;
-  }
-  }
+static void initPort(int index, uart_inst_t *uart, uint rxPin,
+                     irq_handler_t handler) {
+  MidiPort &port = ports[index];
+  port.uart = uart;
+  port.head = 0;
+  port.tail = 0;
+  port.gap = false;
+  // Each port is its own bank of 16 channels; only one may drive the clock
+  midiparser_init(&port.parser, index * 16, index == MIDI_CLOCK_PORT);
+
+  // 31,250 baud, 8 data bits, 1 stop bit, no parity
+  uart_init(uart, MIDI_BAUD_RATE);
+  gpio_set_function(rxPin, GPIO_FUNC_UART);
+  gpio_pull_up(rxPin); // Idle high if nothing is plugged in
+  uart_set_format(uart, 8, 1, UART_PARITY_NONE);
+
+  // Disable the FIFO so every byte raises its own interrupt and gets an
+  // accurate arrival timestamp (with the FIFO on, the RX interrupt only fires
+  // at a fill level or after a 32-bit-period timeout). The ring in RAM
+  // provides the buffering instead.
+  uart_set_fifo_enabled(uart, false);
+
+  int irq = UART_IRQ_NUM(uart);
+  irq_set_exclusive_handler(irq, handler);
+  irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+  irq_set_enabled(irq, true);
+  uart_set_irq_enables(uart, true, false);
 }
 
 // ============================================================================
@@ -178,27 +119,39 @@ static void processByte(uint8_t b) {
 // ============================================================================
 
 void midi_init() {
-  // Initialize UART0 at 31,250 baud
-  uart_init(MIDI_UART_ID, MIDI_BAUD_RATE);
+  midiclock_reset();
 
-  // Set TX and RX pins
+  // The thru output shares UART0 with the first input
+  initPort(0, MIDI_UART_ID, MIDI_RX_PIN, midiUartIrq);
   gpio_set_function(MIDI_TX_PIN, GPIO_FUNC_UART);
-  gpio_set_function(MIDI_RX_PIN, GPIO_FUNC_UART);
+  midithru_init();
 
-  // Configure UART: 8 data bits, 1 stop bit, no parity
-  uart_set_format(MIDI_UART_ID, 8, 1, UART_PARITY_NONE);
-
-  // Enable FIFO (we're polling, but need buffering while LEDs update)
-  uart_set_fifo_enabled(MIDI_UART_ID, true);
+#if MIDI_PORTS > 1
+  initPort(1, MIDI2_UART_ID, MIDI2_RX_PIN, midiUart2Irq);
+#endif
 }
 
-void midi_poll() {
-  // Read all available bytes
-  while (uart_is_readable(MIDI_UART_ID)) {
-    uint8_t b = uart_getc(MIDI_UART_ID);
-    if (b != 0xF8) {
-      printf("MIDI: %02X\n", b); // DEBUG
+void HOT_FUNC(midi_poll)() {
+  // Drain everything the IRQs have queued so far
+  for (int i = 0; i < MIDI_PORTS; i++) {
+    MidiPort &port = ports[i];
+    uint32_t head = port.head;
+    while (port.tail != head) {
+      const RxEntry &e = port.ring[port.tail % MIDI_RX_RING_SIZE];
+#if MIDI_DEBUG_TRACE
+      if (e.b != 0xF8) {
+        printf("MIDI%d: %02X\n", i + 1, e.b);
+      }
+#endif
+      capture_record(i, e.b, e.t_us, e.gap); // Exactly what the parser sees
+      // Live playing stops the show before its first message is drawn, so
+      // releasing the show's notes cannot turn off the live one
+      if (midiparser_completesMessage(&port.parser, e.b) && smfplayer_playing())
+        smfplayer_stop();
+      midiparser_processByte(&port.parser, e.b, e.t_us);
+      port.tail = port.tail + 1;
     }
-    processByte(b);
+    telemetry.ports[i].messages = port.parser.messages;
+    telemetry.ports[i].parserResyncs = port.parser.resyncs;
   }
 }
@@ -3,7 +3,8 @@
 
 #include <stdint.h>
 
-// Initialize MIDI UART (31,250 baud on UART0)
+// Initialize the MIDI inputs (31,250 baud on UART0, plus UART1 when
+// MIDI_PORTS is 2)
 void midi_init();
 
 // Poll for incoming MIDI bytes and fire callbacks
@@ -11,8 +12,14 @@ void midi_init();
 void midi_poll();
 
 // Callbacks implemented by main.cpp
-// These are called when MIDI messages are parsed
+// These are called when MIDI messages are parsed. channel is the logical
+// channel: port * 16 + MIDI channel.
 extern void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity);
 extern void onNoteOff(uint8_t channel, uint8_t note);
+// bend is -8192..8191 around the center
+extern void onPitchBend(uint8_t channel, int16_t bend);
+extern void onChannelPressure(uint8_t channel, uint8_t pressure);
+// Registered parameter 'rpn' (CC 101/100) set by Data Entry MSB (CC 6)
+extern void onParameter(uint8_t channel, uint16_t rpn, uint8_t value);
 
 #endif // MIDI_H
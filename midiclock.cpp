@@ -0,0 +1,141 @@
+#include "midiclock.h"
+#include "hotpath.h"
+
+// ============================================================================
+// Filter Configuration
+// ============================================================================
+
+static const uint32_t PPQN = 24;
+
+// Accepted tick interval range: 20..400 BPM
+static const uint32_t MIN_PERIOD_US = 60000000u / (400 * PPQN);
+static const uint32_t MAX_PERIOD_US = 60000000u / (20 * PPQN);
+
+// Phase correction gain (1/4) and period correction gain (1/32)
+static const int32_t ALPHA_DIV = 4;
+static const int32_t BETA_MUL = 256 / 32; // Period is kept in Q8
+
+// Clock is considered lost after this many missing ticks
+static const uint32_t LOCK_TIMEOUT_TICKS = 4;
+
+// ============================================================================
+// State
+// ============================================================================
+
+static bool running = false;
+static bool pendingStart = false; // Next tick is the first of a new song
+static uint8_t primed = 0;        // Ticks seen since (re)seeding, capped at 2
+static uint32_t lastRawUs = 0;    // Ingest time of the latest tick
+static uint32_t predUs = 0;       // Filtered time of the latest tick
+static uint32_t periodQ8 = 0;     // Filtered tick interval, us * 256
+static uint32_t tickInBeat = 0;   // 0..PPQN-1
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static inline bool inRange(uint32_t period_us) {
+  return period_us >= MIN_PERIOD_US && period_us <= MAX_PERIOD_US;
+}
+
+static void HOT_FUNC(advanceTick)() {
+  if (pendingStart) {
+    tickInBeat = 0;
+    pendingStart = false;
+  } else {
+    tickInBeat = (tickInBeat + 1) % PPQN;
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void midiclock_reset() {
+  running = false;
+  pendingStart = false;
+  primed = 0;
+  lastRawUs = 0;
+  predUs = 0;
+  periodQ8 = 0;
+  tickInBeat = 0;
+}
+
+void HOT_FUNC(midiclock_onTick)(uint32_t t_us) {
+  uint32_t raw = t_us - lastRawUs;
+  lastRawUs = t_us;
+  advanceTick();
+
+  if (primed == 0 || !inRange(raw)) {
+    // First tick, or a dropout: restart the estimate from this tick
+    predUs = t_us;
+    primed = 1;
+    return;
+  }
+
+  if (primed == 1) {
+    // Second tick: seed the period from the raw interval
+    periodQ8 = raw << 8;
+    predUs = t_us;
+    primed = 2;
+    return;
+  }
+
+  uint32_t expected = predUs + (periodQ8 >> 8);
+  int32_t err = (int32_t)(t_us - expected);
+  int32_t half = (int32_t)(periodQ8 >> 9);
+
+  if (err > half || err < -half) {
+    // Tempo jump: re-seed rather than slewing slowly towards it
+    periodQ8 = raw << 8;
+    predUs = t_us;
+    return;
+  }
+
+  predUs = expected + err / ALPHA_DIV;
+  int32_t period = (int32_t)periodQ8 + err * BETA_MUL;
+  if (period < (int32_t)(MIN_PERIOD_US << 8))
+    period = MIN_PERIOD_US << 8;
+  if (period > (int32_t)(MAX_PERIOD_US << 8))
+    period = MAX_PERIOD_US << 8;
+  periodQ8 = (uint32_t)period;
+}
+
+void midiclock_onStart() {
+  running = true;
+  pendingStart = true;
+}
+
+void midiclock_onContinue() { running = true; }
+
+void midiclock_onStop() { running = false; }
+
+bool midiclock_running() { return running; }
+
+bool midiclock_locked(uint32_t now_us) {
+  if (primed < 2)
+    return false;
+  return (now_us - lastRawUs) < LOCK_TIMEOUT_TICKS * (periodQ8 >> 8);
+}
+
+uint32_t midiclock_bpmX100() {
+  if (primed < 2)
+    return 0;
+  // 60e6 us/min * 100 / (period_us * 24), with period in Q8
+  return (uint32_t)(64000000000ull / periodQ8);
+}
+
+uint16_t midiclock_beatPhase(uint32_t now_us) {
+  if (!running || !midiclock_locked(now_us))
+    return 0;
+
+  uint32_t period = periodQ8 >> 8;
+  int32_t since = (int32_t)(now_us - predUs);
+  if (since < 0)
+    since = 0;
+  if ((uint32_t)since >= period)
+    since = period - 1; // Hold at the end of the tick until the next arrives
+
+  uint32_t tickFrac = (uint32_t)(((uint64_t)since << 16) / period);
+  return (uint16_t)(((tickInBeat << 16) + tickFrac) / PPQN);
+}
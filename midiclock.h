@@ -0,0 +1,36 @@
+#ifndef MIDICLOCK_H
+#define MIDICLOCK_H
+
+#include <stdint.h>
+
+// MIDI beat clock tracker (24 PPQN).
+//
+// Tick timestamps are taken at UART ingest and smoothed by an alpha-beta
+// (second order PLL) filter, so BPM and beat phase stay steady even when the
+// sender or the cable adds jitter. Each tick costs O(1) integer work.
+
+// Forget tempo and transport state
+void midiclock_reset();
+
+// Realtime message handlers (timestamp = us since boot at ingest)
+void midiclock_onTick(uint32_t t_us); // 0xF8
+void midiclock_onStart();             // 0xFA
+void midiclock_onContinue();          // 0xFB
+void midiclock_onStop();              // 0xFC
+
+// True between Start/Continue and Stop
+bool midiclock_running();
+
+// True while a steady clock is being received
+bool midiclock_locked(uint32_t now_us);
+
+// Filtered tempo in hundredths of a BPM. 0 until two ticks have seeded the
+// filter; after the clock stops it keeps the last tempo, so check
+// midiclock_locked() for a live one.
+uint32_t midiclock_bpmX100();
+
+// Position within the current quarter note, 0..65535, extrapolated to now_us.
+// Returns 0 when not running or not locked.
+uint16_t midiclock_beatPhase(uint32_t now_us);
+
+#endif // MIDICLOCK_H
@@ -0,0 +1,262 @@
+#include "midiparser.h"
+#include "config.h"
+#include "hotpath.h"
+#include "midi.h"
+#include "midiclock.h"
+#include <cstdio>
+
+// Parser states
+enum MidiState { WAITING_STATUS, WAITING_DATA1, WAITING_DATA2 };
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static inline bool isStatusByte(uint8_t b) { return (b & 0x80) != 0; }
+
+static inline bool isDataByte(uint8_t b) { return (b & 0x80) == 0; }
+
+static inline uint8_t getMessageType(uint8_t status) { return status & 0xF0; }
+
+static inline uint8_t getChannel(uint8_t status) { return status & 0x0F; }
+
+// ============================================================================
+// Message Handlers
+// ============================================================================
+
+static void HOT_FUNC(handleNoteOff)(uint8_t channel, uint8_t note, uint8_t velocity) {
+  (void)velocity; // Unused
+  onNoteOff(channel, note);
+}
+
+static void HOT_FUNC(handleNoteOn)(uint8_t channel, uint8_t note, uint8_t velocity) {
+  if (velocity == 0) {
+    // Note On with velocity 0 is treated as Note Off
+    onNoteOff(channel, note);
+  } else {
+    onNoteOn(channel, note, velocity);
+  }
+}
+
+static void HOT_FUNC(handleControlChange)(MidiParser *p, uint8_t channel,
+                                          uint8_t controller, uint8_t value) {
+  uint16_t &rpn = p->rpn[channel - p->channelOffset];
+
+  switch (controller) {
+  case 0x7B: // All Notes Off
+    // Fire note-off for all 128 possible notes on this channel
+    for (int note = 0; note < 128; note++) {
+      onNoteOff(channel, note);
+    }
+    break;
+
+  // Registered parameters: select with CC 101/100, set with Data Entry MSB
+  case 0x65:
+    rpn = (uint16_t)((value << 7) | (rpn & 0x7F));
+    break;
+  case 0x64:
+    rpn = (uint16_t)((rpn & 0x3F80) | value);
+    break;
+  case 0x63: // NRPN select: data entry no longer goes to an RPN
+  case 0x62:
+    rpn = MIDI_RPN_NULL;
+    break;
+  case 0x06:
+    if (rpn != MIDI_RPN_NULL)
+      onParameter(channel, rpn, value);
+    break;
+
+  // All other CCs are ignored
+  default:
+    break;
+  }
+}
+
+// Program Change and Channel Pressure: complete after one data byte
+static void HOT_FUNC(dispatchShort)(MidiParser *p) {
+  if (getMessageType(p->currentStatus) == 0xD0)
+    onChannelPressure(getChannel(p->currentStatus) + p->channelOffset,
+                      p->data1);
+  p->state = WAITING_STATUS;
+  p->messages++;
+}
+
+// ============================================================================
+// State Machine
+// ============================================================================
+
+void HOT_FUNC(midiparser_processByte)(MidiParser *p, uint8_t b, uint32_t t_us) {
+#if MIDI_DEBUG_TRACE
+  if (b < 0xF8) { // Ignore clock
+    printf("Parser[%d] Byte: %02X\n", p->state, b);
+  }
+#endif
+
+  // Real-time messages may appear anywhere, even inside SysEx or between
+  // the data bytes of another message, and never affect running status
+  if (b >= 0xF8) {
+    if (!p->realtime)
+      return;
+    switch (b) {
+    case 0xF8:
+      midiclock_onTick(t_us);
+      break;
+    case 0xFA:
+      midiclock_onStart();
+      break;
+    case 0xFB:
+      midiclock_onContinue();
+      break;
+    case 0xFC:
+      midiclock_onStop();
+      break;
+    default: // Active Sensing, Reset, undefined: ignore
+      break;
+    }
+    return;
+  }
+
+  // Handle SysEx mode
+  if (p->inSysEx) {
+    if (b == 0xF7) {
+      p->inSysEx = false; // End of SysEx
+    }
+    return; // Consume all SysEx bytes
+  }
+
+  // Check for new status byte
+  if (isStatusByte(b)) {
+    if (b == 0xF0) {
+      // Start of SysEx
+      p->inSysEx = true;
+      p->runningStatus = 0; // Clear running status
+      return;
+    }
+
+    if (b >= 0xF0) {
+      // System Common messages (ignore, clear running status)
+      p->runningStatus = 0;
+      return;
+    }
+
+    // Channel voice message
+    if (p->state != WAITING_STATUS)
+      p->resyncs++; // Previous message never completed
+    p->currentStatus = b;
+    p->runningStatus = b;
+    p->state = WAITING_DATA1;
+    // printf("State -> WAITING_DATA1\n");
+    return;
+  }
+
+  // Data byte handling
+  if (!isDataByte(b)) {
+    return; // Invalid byte, ignore
+  }
+
+  switch (p->state) {
+  case WAITING_STATUS: {
+    // Unexpected data byte - use running status if available
+    if (p->runningStatus != 0) {
+      p->currentStatus = p->runningStatus;
+      p->data1 = b;
+
+      uint8_t msgType = getMessageType(p->currentStatus);
+      if (msgType == 0xC0 || msgType == 0xD0) {
+        // Program Change and Channel Pressure have only 1 data byte
+        dispatchShort(p);
+      } else {
+        p->state = WAITING_DATA2;
+      }
+    }
+    break;
+  }
+
+  case WAITING_DATA1: {
+    p->data1 = b;
+
+    uint8_t msgType = getMessageType(p->currentStatus);
+    if (msgType == 0xC0 || msgType == 0xD0) {
+      // Program Change and Channel Pressure have only 1 data byte
+      dispatchShort(p);
+    } else {
+      p->state = WAITING_DATA2;
+    }
+    break;
+  }
+
+  case WAITING_DATA2: {
+    uint8_t data2 = b;
+    uint8_t channel = getChannel(p->currentStatus) + p->channelOffset;
+    uint8_t msgType = getMessageType(p->currentStatus);
+
+    // Dispatch message
+#if MIDI_DEBUG_TRACE
+    printf("Dispatch! Ch:%d Msg:%02X D1:%02X D2:%02X\n", channel, msgType,
+           p->data1, data2);
+#endif
+    switch (msgType) {
+    case 0x80: // Note Off
+      handleNoteOff(channel, p->data1, data2);
+      break;
+
+    case 0x90: // Note On
+      handleNoteOn(channel, p->data1, data2);
+      break;
+
+    case 0xB0: // Control Change
+      handleControlChange(p, channel, p->data1, data2);
+      break;
+
+    case 0xE0: // Pitch Bend: LSB, MSB around the 0x2000 center
+      onPitchBend(channel, (int16_t)(((data2 << 7) | p->data1) - 0x2000));
+      break;
+
+    // All other message types are silently ignored
+    default:
+      break;
+    }
+
+    p->state = WAITING_STATUS;
+    p->messages++;
+    break;
+  }
+  }
+}
+
+bool HOT_FUNC(midiparser_completesMessage)(const MidiParser *p, uint8_t b) {
+  if (!isDataByte(b) || p->inSysEx)
+    return false;
+
+  uint8_t status;
+  if (p->state == WAITING_DATA2)
+    return true;
+  if (p->state == WAITING_DATA1)
+    status = p->currentStatus;
+  else if (p->runningStatus != 0)
+    status = p->runningStatus;
+  else
+    return false;
+
+  uint8_t msgType = getMessageType(status);
+  return msgType == 0xC0 || msgType == 0xD0;
+}
+
+void midiparser_init(MidiParser *p, uint8_t channelOffset, bool realtime) {
+  p->channelOffset = channelOffset;
+  p->realtime = realtime;
+  p->messages = 0;
+  p->resyncs = 0;
+  for (int i = 0; i < 16; i++) {
+    p->rpn[i] = MIDI_RPN_NULL;
+  }
+  midiparser_reset(p);
+}
+
+void midiparser_reset(MidiParser *p) {
+  p->state = WAITING_STATUS;
+  p->runningStatus = 0;
+  p->currentStatus = 0;
+  p->data1 = 0;
+  p->inSysEx = false;
+}
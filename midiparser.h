@@ -0,0 +1,42 @@
+#ifndef MIDIPARSER_H
+#define MIDIPARSER_H
+
+#include <stdint.h>
+
+// MIDI byte stream parser.
+//
+// Pure state machine with no hardware access: midi.cpp feeds it from the
+// UART ring, and host tools link it directly to replay captured traffic.
+// Parsed messages go to the callbacks in midi.h and the midiclock handlers.
+
+#define MIDI_RPN_NULL 0x3FFF // No parameter selected (or an NRPN is)
+
+struct MidiParser {
+  uint8_t channelOffset; // Added to the MIDI channel (input port bank)
+  bool realtime;         // Forward clock/transport to midiclock
+  uint8_t state;
+  uint8_t runningStatus;
+  uint8_t currentStatus;
+  uint8_t data1;
+  bool inSysEx;
+  uint16_t rpn[16]; // Selected registered parameter per MIDI channel
+
+  // Statistics (kept across midiparser_reset)
+  uint32_t messages; // Complete channel messages
+  uint32_t resyncs;  // Partial messages abandoned for a new status byte
+};
+
+// Set up a parser whose channels map to channelOffset + 0..15 and clear
+// its statistics
+void midiparser_init(MidiParser *p, uint8_t channelOffset, bool realtime);
+
+// Clear running status and any partial message
+void midiparser_reset(MidiParser *p);
+
+// Feed one byte received at t_us (us since boot, taken at ingest)
+void midiparser_processByte(MidiParser *p, uint8_t b, uint32_t t_us);
+
+// True if feeding b next would complete a channel message (and dispatch it)
+bool midiparser_completesMessage(const MidiParser *p, uint8_t b);
+
+#endif // MIDIPARSER_H
@@ -0,0 +1,272 @@
+#include "midithru.h"
+#include "config.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+#include "hotpath.h"
+#include "pico/stdlib.h"
+
+#if MIDI_THRU_MODE != MIDI_THRU_OFF
+
+// ============================================================================
+// Output Ring
+// ============================================================================
+
+// The DMA reads the ring with address wrapping, so its read pointer always
+// sits at txDone. The producers (RX interrupt, DMA IRQ, midithru_send with
+// interrupts off) never run concurrently.
+static const uint32_t RING_SIZE = 1u << MIDI_THRU_RING_BITS;
+static uint8_t txRing[RING_SIZE] __attribute__((aligned(RING_SIZE)));
+static volatile uint32_t txHead = 0;     // Next byte to queue
+static volatile uint32_t txDone = 0;     // Bytes the DMA has finished
+static volatile uint32_t txInFlight = 0; // Bytes in the current transfer
+static volatile uint32_t dropped = 0;
+static int txDma = -1;
+
+// Start a transfer for everything queued, unless one is already running
+static void HOT_FUNC(kick)() {
+  if (txInFlight != 0)
+    return;
+  uint32_t n = txHead - txDone;
+  if (n == 0)
+    return;
+  txInFlight = n;
+  dma_channel_set_trans_count(txDma, n, true);
+}
+
+// Queue n bytes as a unit, or none of them
+static bool HOT_FUNC(put)(const uint8_t *p, uint32_t n) {
+  uint32_t head = txHead;
+  if (RING_SIZE - (head - txDone) < n) {
+    dropped++;
+    return false;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    txRing[(head + i) & (RING_SIZE - 1)] = p[i];
+  }
+  txHead = head + n;
+  kick();
+  return true;
+}
+
+static void __isr HOT_FUNC(thruDmaIrq)() {
+  dma_channel_acknowledge_irq1(txDma);
+  txDone = txDone + txInFlight;
+  txInFlight = 0;
+  kick(); // Bytes queued while the last transfer ran
+}
+
+#endif
+
+#if MIDI_THRU_MODE == MIDI_THRU_MERGE
+
+// ============================================================================
+// Merge
+// ============================================================================
+
+// Per-input message assembly
+struct ThruPort {
+  uint8_t status; // Current (running) status, 0 if none
+  uint8_t need;   // Data bytes per message for status
+  uint8_t n;      // Data bytes received so far
+  uint8_t data[2];
+};
+
+static ThruPort ports[MIDI_PORTS];
+static int sysexOwner = -1;   // Port whose SysEx is passing through
+static uint32_t sysexLastUs;  // When its last byte arrived
+static uint8_t txRunning = 0; // Running status on the output
+
+static uint8_t dataBytes(uint8_t status) {
+  switch (status & 0xF0) {
+  case 0xC0: // Program Change
+  case 0xD0: // Channel Pressure
+    return 1;
+  case 0xF0:
+    if (status == 0xF1 || status == 0xF3) // MTC quarter frame, song select
+      return 1;
+    if (status == 0xF2) // Song position
+      return 2;
+    return 0;
+  default:
+    return 2;
+  }
+}
+
+// Queue one complete message, dropping the status byte when running status
+// allows it
+static bool HOT_FUNC(emit)(uint8_t status, const uint8_t *data, uint8_t n) {
+  if (sysexOwner >= 0) {
+    dropped++; // Would split someone else's SysEx
+    return false;
+  }
+
+  uint8_t buf[3];
+  uint8_t len = 0;
+  bool channelMsg = status < 0xF0;
+  if (!channelMsg || status != txRunning)
+    buf[len++] = status;
+  for (uint8_t i = 0; i < n; i++) {
+    buf[len++] = data[i];
+  }
+  if (!put(buf, len))
+    return false;
+  txRunning = channelMsg ? status : 0;
+  return true;
+}
+
+// Close the SysEx on the output, so the downstream parser resyncs
+static void HOT_FUNC(endSysex)() {
+  uint8_t eox = 0xF7;
+  put(&eox, 1);
+  sysexOwner = -1;
+}
+
+// A sender unplugged mid-SysEx would otherwise hold the output forever
+static void HOT_FUNC(expireSysex)() {
+  if (sysexOwner >= 0 &&
+      time_us_32() - sysexLastUs > MIDI_THRU_SYSEX_TIMEOUT_MS * 1000u)
+    endSysex(); // Its late data bytes have no status and are dropped
+}
+
+static void HOT_FUNC(mergeByte)(int src, uint8_t b) {
+  ThruPort &p = ports[src];
+
+  // Realtime may go out between any two bytes
+  if (b >= 0xF8) {
+    put(&b, 1);
+    return;
+  }
+
+  if (sysexOwner != src)
+    expireSysex();
+
+  if (sysexOwner == src) {
+    if (b < 0x80) {
+      put(&b, 1);
+      sysexLastUs = time_us_32();
+      return;
+    }
+    // Any status byte ends the SysEx
+    endSysex();
+    if (b == 0xF7)
+      return;
+  }
+
+  if (b & 0x80) {
+    p.n = 0;
+    if (b == 0xF0) {
+      p.status = 0; // Data bytes are SysEx, not running status
+      if (sysexOwner >= 0) {
+        dropped++; // One SysEx at a time
+        return;
+      }
+      if (put(&b, 1)) {
+        sysexOwner = src;
+        sysexLastUs = time_us_32();
+        txRunning = 0;
+      }
+      return;
+    }
+    p.status = b;
+    p.need = dataBytes(b);
+    if (p.need == 0) { // Tune request, or stray EOX / undefined
+      if (b == 0xF6)
+        emit(b, nullptr, 0);
+      p.status = 0;
+    }
+    return;
+  }
+
+  if (p.status == 0)
+    return; // Data with no status to attach it to
+
+  p.data[p.n++] = b;
+  if (p.n == p.need) {
+    emit(p.status, p.data, p.n);
+    p.n = 0;
+    if (p.status >= 0xF0)
+      p.status = 0; // System common messages do not run
+  }
+}
+
+#endif
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+#if MIDI_THRU_MODE != MIDI_THRU_OFF
+
+void midithru_init() {
+  txDma = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(txDma);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_ring(&c, false, MIDI_THRU_RING_BITS);
+  channel_config_set_dreq(&c, uart_get_dreq(MIDI_UART_ID, true));
+  dma_channel_configure(txDma, &c, &uart_get_hw(MIDI_UART_ID)->dr, txRing, 0,
+                        false);
+
+  // Same priority as the UART RX interrupt, so neither preempts the other
+  // while they share the ring
+  dma_channel_set_irq1_enabled(txDma, true);
+  irq_set_exclusive_handler(DMA_IRQ_1, thruDmaIrq);
+  irq_set_priority(DMA_IRQ_1, PICO_HIGHEST_IRQ_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, true);
+}
+
+uint32_t midithru_dropped() { return dropped; }
+
+#else
+
+void midithru_init() {}
+uint32_t midithru_dropped() { return 0; }
+
+#endif
+
+void HOT_FUNC(midithru_input)(int src, uint8_t b) {
+#if MIDI_THRU_MODE == MIDI_THRU_RAW
+  if (src == 0)
+    put(&b, 1);
+#elif MIDI_THRU_MODE == MIDI_THRU_MERGE
+  if (src >= 0 && src < MIDI_PORTS)
+    mergeByte(src, b);
+#else
+  (void)src;
+  (void)b;
+#endif
+}
+
+bool midithru_send(const uint8_t *msg, int len) {
+#if MIDI_THRU_MODE == MIDI_THRU_MERGE
+  if (len <= 0)
+    return false;
+
+  uint32_t irq = save_and_disable_interrupts();
+  expireSysex();
+  bool ok;
+  if (msg[0] >= 0xF8) {
+    ok = put(msg, 1);
+  } else if (msg[0] == 0xF0) {
+    // Whole SysEx in one piece, so nothing can land in the middle
+    ok = sysexOwner < 0 && put(msg, (uint32_t)len);
+    if (ok)
+      txRunning = 0;
+    else if (sysexOwner >= 0)
+      dropped++;
+  } else if ((msg[0] & 0x80) && len == 1 + dataBytes(msg[0])) {
+    ok = emit(msg[0], &msg[1], (uint8_t)(len - 1));
+  } else {
+    ok = false;
+  }
+  restore_interrupts(irq);
+  return ok;
+#else
+  (void)msg;
+  (void)len;
+  return false;
+#endif
+}
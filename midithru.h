@@ -0,0 +1,34 @@
+#ifndef MIDITHRU_H
+#define MIDITHRU_H
+
+#include <stdint.h>
+
+// MIDI Thru / merge output on MIDI_TX_PIN.
+//
+// Bytes are queued in a RAM ring and sent to the UART TX by DMA, so
+// forwarding costs a few instructions in the RX interrupt and keeps going
+// while the CPU renders or the LEDs transmit.
+//
+// MIDI_THRU_RAW forwards input port 0 byte for byte (lowest latency).
+// MIDI_THRU_MERGE assembles complete messages from every input port and from
+// midithru_send(), then re-encodes them with running status for the output.
+// A SysEx holds the output for its port until F7 or any other status byte
+// from that port, or until it has been silent for MIDI_THRU_SYSEX_TIMEOUT_MS
+// (checked when another port or midithru_send() wants the output). An F7 is
+// inserted if the port did not send one.
+// Realtime bytes are forwarded immediately in both modes.
+
+// Claim the DMA channel (called from midi_init() after the UART is set up)
+void midithru_init();
+
+// Feed one received byte from input port src (called from the RX interrupt)
+void midithru_input(int src, uint8_t b);
+
+// Queue a complete locally generated message (merge mode only). Returns
+// false if it was not queued: ring full, or another port is mid-SysEx.
+bool midithru_send(const uint8_t *msg, int len);
+
+// Messages/bytes discarded because the output could not take them
+uint32_t midithru_dropped();
+
+#endif // MIDITHRU_H
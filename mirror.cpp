@@ -0,0 +1,169 @@
+#include "mirror.h"
+#include "config.h"
+#include "console.h"
+#include "leds.h"
+#include "pico/stdlib.h"
+#include <cstdio>
+#include <string.h>
+
+#if ENABLE_MIRROR
+
+static const int HEADER_BYTES = 8;
+static const int MAX_RUN = 128;
+// Worst case: every pixel is a run of its own (opcode + RGB)
+static const int MAX_PACKET = HEADER_BYTES + LED_COUNT * 4 + 1;
+// A host that stops reading gets a cut packet (the viewer drops it)
+static const uint32_t FINISH_TIMEOUT_US = 100000;
+
+// ============================================================================
+// State
+// ============================================================================
+
+static bool enabled = false;
+static bool captured = false;     // frame[] is waiting to be encoded
+static uint32_t frame[LED_COUNT]; // Captured frame (0x00RRGGBB, row-major)
+static uint32_t sent[LED_COUNT];  // Frame the host has after the last packet
+
+static uint8_t packet[MAX_PACKET];
+static int packetLen = 0; // Encoded bytes
+static int packetPos = 0; // Bytes handed to USB so far
+
+static uint8_t seq = 0;
+static int sinceKeyframe = 0;
+static uint32_t framesSent = 0;
+static uint32_t framesDropped = 0; // Previous packet still going out
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// Runs of frame[] against sent[]; returns the payload length
+static int encodeRuns(uint8_t *out) {
+  uint8_t *p = out;
+  int i = 0;
+  while (i < LED_COUNT) {
+    int n = 1;
+    if (frame[i] == sent[i]) {
+      while (i + n < LED_COUNT && n < MAX_RUN && frame[i + n] == sent[i + n])
+        n++;
+      *p++ = (uint8_t)(n - 1);
+    } else {
+      // A color run may cover unchanged pixels too; flat tiles stay one run
+      uint32_t c = frame[i];
+      while (i + n < LED_COUNT && n < MAX_RUN && frame[i + n] == c)
+        n++;
+      *p++ = (uint8_t)(0x80 | (n - 1));
+      *p++ = (uint8_t)(c >> 16);
+      *p++ = (uint8_t)(c >> 8);
+      *p++ = (uint8_t)c;
+    }
+    i += n;
+  }
+  return (int)(p - out);
+}
+
+static void buildPacket() {
+  bool keyframe = sinceKeyframe >= MIRROR_KEYFRAME_FRAMES;
+  if (keyframe) {
+    memset(sent, 0, sizeof(sent));
+    sinceKeyframe = 0;
+  } else {
+    sinceKeyframe++;
+  }
+
+  int len = encodeRuns(packet + HEADER_BYTES);
+  uint8_t sum = 0;
+  for (int i = 0; i < len; i++) {
+    sum += packet[HEADER_BYTES + i];
+  }
+
+  packet[0] = MIRROR_MAGIC0;
+  packet[1] = MIRROR_MAGIC1;
+  packet[2] = keyframe ? MIRROR_KEYFRAME : MIRROR_DELTA;
+  packet[3] = seq++;
+  packet[4] = PANEL_WIDTH;
+  packet[5] = PANEL_HEIGHT;
+  packet[6] = (uint8_t)len;
+  packet[7] = (uint8_t)(len >> 8);
+  packet[HEADER_BYTES + len] = sum;
+  packetLen = HEADER_BYTES + len + 1;
+  packetPos = 0;
+
+  memcpy(sent, frame, sizeof(sent));
+  framesSent++;
+}
+
+// Console: send the rest of the packet in flight before a command writes
+static void finishPacket() {
+  uint64_t lastProgress = time_us_64();
+  while (packetPos < packetLen &&
+         time_us_64() - lastProgress < FINISH_TIMEOUT_US) {
+    size_t n = console_writeSome(packet + packetPos,
+                                 (size_t)(packetLen - packetPos));
+    if (n > 0) {
+      packetPos += (int)n;
+      lastProgress = time_us_64();
+    }
+  }
+  packetPos = packetLen;
+}
+
+static void setEnabled(bool on) {
+  enabled = on;
+  console_setStream(on ? finishPacket : nullptr);
+  captured = false;
+  packetLen = packetPos = 0;
+  sinceKeyframe = MIRROR_KEYFRAME_FRAMES; // Start with a keyframe
+}
+
+static void mirrorCommand(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "on") == 0) {
+    setEnabled(true);
+  } else if (argc > 1 && strcmp(argv[1], "off") == 0) {
+    setEnabled(false);
+  }
+  printf("Mirror: %s, %lu frames sent, %lu dropped\n", enabled ? "on" : "off",
+         (unsigned long)framesSent, (unsigned long)framesDropped);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void mirror_init() {
+  console_addCommand("mirror", mirrorCommand,
+                     "Stream frames to tools/mirror_view.py: on | off");
+}
+
+void mirror_frame() {
+  if (!enabled)
+    return;
+  if (packetPos < packetLen) {
+    framesDropped++;
+    return;
+  }
+  // An unencoded capture is simply replaced by the newer frame
+  leds_readFrame(frame);
+  captured = true;
+}
+
+void mirror_service() {
+  if (!enabled)
+    return;
+  if (packetPos == packetLen && captured) {
+    buildPacket();
+    captured = false;
+  }
+  if (packetPos < packetLen) {
+    packetPos += (int)console_writeSome(packet + packetPos,
+                                        (size_t)(packetLen - packetPos));
+  }
+}
+
+#else
+
+void mirror_init() {}
+void mirror_frame() {}
+void mirror_service() {}
+
+#endif
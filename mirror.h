@@ -0,0 +1,46 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <stdint.h>
+
+// Live frame mirror over USB serial, for watching a rig remotely.
+//
+// When enabled ('mirror on'), each presented frame is sent to the host as a
+// delta against the last frame sent, run-length encoded, so flat tiles cost
+// a few bytes. The frame task only copies the pixels; encoding and sending
+// happen in a low-priority task that writes no more than the USB FIFO takes,
+// so a slow host drops frames instead of stalling MIDI or rendering.
+// Viewer: tools/mirror_view.py.
+//
+// Packet (little endian):
+//   'M' 'R'                magic
+//   uint8 type             'K' keyframe (against black) or 'D' delta
+//   uint8 seq              a delta applies to the frame with seq - 1
+//   uint8 width, height
+//   uint16 length          payload bytes
+//   payload                runs in row-major order:
+//                            0x00 | (n - 1)        n pixels unchanged
+//                            0x80 | (n - 1), R G B n pixels of this color
+//   uint8 checksum         sum of the payload bytes
+//
+// While the mirror is on, the console drops stray text and runs commands
+// between packets (console_setStream), so tools/capture_download.py and
+// tools/telemetry_poll.py still work. The viewer skips anything that is not
+// a packet or fails the checksum, and waits for the next keyframe.
+
+#define MIRROR_MAGIC0 'M'
+#define MIRROR_MAGIC1 'R'
+#define MIRROR_KEYFRAME 'K'
+#define MIRROR_DELTA 'D'
+
+// Register the 'mirror' command
+void mirror_init();
+
+// Take a copy of the frame that is about to be shown (call before
+// leds_show). Does nothing when the mirror is off or still sending.
+void mirror_frame();
+
+// Encode the captured frame and send what the USB FIFO has room for
+void mirror_service();
+
+#endif // MIRROR_H
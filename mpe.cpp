@@ -0,0 +1,257 @@
+#include "mpe.h"
+#include "config.h"
+#include "hotpath.h"
+#include "layout.h"
+#include <cstdio>
+
+#if ENABLE_MPE
+
+static const uint8_t NONE = 0xFF;
+static const uint16_t RPN_BEND_RANGE = 0;
+static const uint16_t RPN_MPE_CONFIG = 6;
+static const uint8_t DEFAULT_BEND_RANGE = 48; // Member channels, per the spec
+static const uint8_t DEFAULT_MANAGER_BEND_RANGE = 2;
+
+// ============================================================================
+// State
+// ============================================================================
+
+struct MemberState {
+  uint8_t note; // Note held on this member channel, or NONE
+  uint8_t pressure;
+  int16_t bend;
+};
+
+static uint8_t managerOf[MAX_CHANNELS]; // Zone manager of a member, or NONE
+static bool isManager[MAX_CHANNELS];
+static MemberState members[MAX_CHANNELS];      // Manager slots: zone bend
+static uint8_t bendRange[MAX_CHANNELS];        // Member bend range, by manager
+static uint8_t managerBendRange[MAX_CHANNELS]; // The manager's own range
+
+static uint8_t lowerMembers[MIDI_PORTS];
+static uint8_t upperMembers[MIDI_PORTS];
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// True if a member channel of manager m other than 'except' holds note
+static bool noteHeld(int m, int note, int except) {
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    if (c != except && managerOf[c] == m && members[c].note == note)
+      return true;
+  }
+  return false;
+}
+
+// Channel c leaves its zone: its held note goes dark on the zone's tile
+static void releaseMember(int c) {
+  int m = managerOf[c];
+  if (m != NONE && members[c].note != NONE &&
+      !noteHeld(m, members[c].note, c))
+    setNoteActive(m, members[c].note, false);
+  members[c] = {NONE, 0, 0};
+}
+
+// Recompute which channels of a port belong to which zone
+static void applyZones(int port) {
+  int base = port * 16;
+  int lower = lowerMembers[port];
+  int upper = upperMembers[port];
+  isManager[base] = lower > 0;
+  isManager[base + 15] = upper > 0;
+
+  for (int i = 0; i < 16; i++) {
+    int c = base + i;
+    uint8_t m = NONE;
+    if (i >= 1 && i <= lower)
+      m = (uint8_t)base;
+    else if (i <= 14 && i >= 15 - upper)
+      m = (uint8_t)(base + 15);
+    if (managerOf[c] == m)
+      continue;
+
+    releaseMember(c);
+    managerOf[c] = m;
+    if (m != NONE)
+      layout_removeChannel(c); // Its notes now split the manager's tile
+  }
+}
+
+// MPE Configuration Message. A zone that grows shrinks the other one.
+static void configureZone(int port, bool upperZone, int count) {
+  if (count > 15)
+    count = 15;
+  if (upperZone) {
+    upperMembers[port] = (uint8_t)count;
+    if (lowerMembers[port] + count > 14)
+      lowerMembers[port] = (uint8_t)(count >= 14 ? 0 : 14 - count);
+    bendRange[port * 16 + 15] = DEFAULT_BEND_RANGE;
+    managerBendRange[port * 16 + 15] = DEFAULT_MANAGER_BEND_RANGE;
+  } else {
+    lowerMembers[port] = (uint8_t)count;
+    if (upperMembers[port] + count > 14)
+      upperMembers[port] = (uint8_t)(count >= 14 ? 0 : 14 - count);
+    bendRange[port * 16] = DEFAULT_BEND_RANGE;
+    managerBendRange[port * 16] = DEFAULT_MANAGER_BEND_RANGE;
+  }
+  applyZones(port);
+  printf("MPE: port %d lower zone %d, upper zone %d member channels\n",
+         port + 1, lowerMembers[port], upperMembers[port]);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void mpe_init() {
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    managerOf[c] = NONE;
+    isManager[c] = false;
+    members[c] = {NONE, 0, 0};
+    bendRange[c] = DEFAULT_BEND_RANGE;
+    managerBendRange[c] = DEFAULT_MANAGER_BEND_RANGE;
+  }
+  for (int port = 0; port < MIDI_PORTS; port++) {
+    lowerMembers[port] = 0;
+    upperMembers[port] = 0;
+    if (MPE_LOWER_ZONE_MEMBERS > 0)
+      configureZone(port, false, MPE_LOWER_ZONE_MEMBERS);
+    if (MPE_UPPER_ZONE_MEMBERS > 0)
+      configureZone(port, true, MPE_UPPER_ZONE_MEMBERS);
+  }
+}
+
+int HOT_FUNC(mpe_noteOn)(int channel, int note) {
+  if (channel < 0 || channel >= MAX_CHANNELS || managerOf[channel] == NONE)
+    return channel;
+  members[channel].note = (uint8_t)note;
+  return managerOf[channel];
+}
+
+bool HOT_FUNC(mpe_noteOff)(int channel, int note, int *tileChannel) {
+  *tileChannel = channel;
+  if (channel < 0 || channel >= MAX_CHANNELS || managerOf[channel] == NONE)
+    return true;
+
+  int m = managerOf[channel];
+  *tileChannel = m;
+  if (members[channel].note == note)
+    members[channel].note = NONE;
+  return !noteHeld(m, note, channel);
+}
+
+void mpe_pitchBend(int channel, int16_t bend) {
+  if (channel >= 0 && channel < MAX_CHANNELS)
+    members[channel].bend = bend;
+}
+
+void mpe_pressure(int channel, uint8_t pressure) {
+  if (channel >= 0 && channel < MAX_CHANNELS)
+    members[channel].pressure = pressure;
+}
+
+void mpe_parameter(int channel, uint16_t rpn, uint8_t value) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+
+  int port = channel / 16;
+  int i = channel % 16;
+  if (rpn == RPN_MPE_CONFIG && (i == 0 || i == 15)) {
+    configureZone(port, i == 15, value);
+  } else if (rpn == RPN_BEND_RANGE && isManager[channel]) {
+    managerBendRange[channel] = value;
+  } else if (rpn == RPN_BEND_RANGE && managerOf[channel] != NONE) {
+    // Sent on any member channel, applies to the whole zone
+    bendRange[managerOf[channel]] = value;
+  }
+}
+
+bool HOT_FUNC(mpe_expression)(int tileChannel, int note, int32_t *bend,
+                              uint32_t *level) {
+  if (!isManager[tileChannel])
+    return false;
+
+  // Manager channel bend moves every note of the zone
+  int32_t zoneBend = members[tileChannel].bend *
+                     managerBendRange[tileChannel] * 256 / 8192;
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    if (managerOf[c] != tileChannel || members[c].note != note)
+      continue;
+    *bend = zoneBend + members[c].bend * bendRange[tileChannel] * 256 / 8192;
+    *level = MPE_PRESSURE_FLOOR +
+             members[c].pressure * (256 - MPE_PRESSURE_FLOOR) / 127;
+    return true;
+  }
+  if (zoneBend == 0)
+    return false;
+  *bend = zoneBend; // Played on the manager channel itself
+  *level = 256;
+  return true;
+}
+
+void mpe_getChannel(int channel, MpeChannelState *out) {
+  if (channel < 0 || channel >= MAX_CHANNELS) {
+    *out = {NONE, false, NONE, 0, 0, 0, 0};
+    return;
+  }
+  *out = {managerOf[channel],         isManager[channel],
+          members[channel].note,      members[channel].pressure,
+          members[channel].bend,      bendRange[channel],
+          managerBendRange[channel]};
+}
+
+// Link followers: no zone logic runs, the master's state is copied as is
+void mpe_setChannel(int channel, const MpeChannelState &s) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+  managerOf[channel] = s.manager;
+  isManager[channel] = s.isManager;
+  members[channel] = {s.note, s.pressure, s.bend};
+  bendRange[channel] = s.bendRange;
+  managerBendRange[channel] = s.managerBendRange;
+}
+
+#else
+
+void mpe_init() {}
+int mpe_noteOn(int channel, int note) {
+  (void)note;
+  return channel;
+}
+bool mpe_noteOff(int channel, int note, int *tileChannel) {
+  (void)note;
+  *tileChannel = channel;
+  return true;
+}
+void mpe_pitchBend(int channel, int16_t bend) {
+  (void)channel;
+  (void)bend;
+}
+void mpe_pressure(int channel, uint8_t pressure) {
+  (void)channel;
+  (void)pressure;
+}
+void mpe_parameter(int channel, uint16_t rpn, uint8_t value) {
+  (void)channel;
+  (void)rpn;
+  (void)value;
+}
+bool mpe_expression(int tileChannel, int note, int32_t *bend,
+                    uint32_t *level) {
+  (void)tileChannel;
+  (void)note;
+  (void)bend;
+  (void)level;
+  return false;
+}
+void mpe_getChannel(int channel, MpeChannelState *out) {
+  (void)channel;
+  *out = {0xFF, false, 0xFF, 0, 0, 0, 0};
+}
+void mpe_setChannel(int channel, const MpeChannelState &s) {
+  (void)channel;
+  (void)s;
+}
+
+#endif
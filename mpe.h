@@ -0,0 +1,59 @@
+#ifndef MPE_H
+#define MPE_H
+
+#include <stdint.h>
+
+// MIDI Polyphonic Expression (MPE) zones.
+//
+// An MPE controller plays every note on a member channel of its own. Member
+// channels fold into their zone's manager channel: they share its tile and
+// color, so a new note only splits a note tile instead of adding a channel
+// and reflowing the wall. Pitch bend and channel pressure are kept per
+// member channel, and the renderer reads them back to move and dim the
+// note's tile. Pitch bend on the manager channel (scaled by the manager's
+// own RPN 0 range, 2 semitones by default) adds to every note in the zone.
+//
+// Zones are per input port. The MPE Configuration Message (RPN 6 on MIDI
+// channel 1 for the lower zone, 16 for the upper) sets the member count, or
+// MPE_LOWER_ZONE_MEMBERS / MPE_UPPER_ZONE_MEMBERS preset it at boot.
+// Channels that had tiles of their own before joining a zone lose them.
+//
+// Link followers get no MIDI: the master sends them each channel's state
+// (mpe_getChannel / mpe_setChannel), so they draw the same expression.
+
+// Apply the preset zones
+void mpe_init();
+
+// Note events, before the layout sees them. Returns the channel whose tile
+// the note is drawn on: the zone manager for member channels, else channel.
+int mpe_noteOn(int channel, int note);
+
+// Sets *tileChannel like mpe_noteOn(). Returns false if another member
+// channel still holds the same note, so the tile must stay lit.
+bool mpe_noteOff(int channel, int note, int *tileChannel);
+
+void mpe_pitchBend(int channel, int16_t bend);
+void mpe_pressure(int channel, uint8_t pressure);
+void mpe_parameter(int channel, uint16_t rpn, uint8_t value);
+
+// Expression of a note held by a member channel of the zone drawn on
+// tileChannel: pitch bend in 1/256 semitones and brightness 0..256.
+// Returns false for notes outside a zone, and for notes played on the
+// manager channel itself while the zone is not bent.
+bool mpe_expression(int tileChannel, int note, int32_t *bend, uint32_t *level);
+
+// Everything mpe_expression() reads about one channel
+struct MpeChannelState {
+  uint8_t manager; // Zone manager of a member channel, 0xFF if none
+  bool isManager;
+  uint8_t note; // Note held on a member channel, 0xFF if none
+  uint8_t pressure;
+  int16_t bend;
+  uint8_t bendRange;        // Member bend range (zone managers)
+  uint8_t managerBendRange; // The manager's own range
+};
+
+void mpe_getChannel(int channel, MpeChannelState *out);
+void mpe_setChannel(int channel, const MpeChannelState &s);
+
+#endif // MPE_H
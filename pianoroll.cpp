@@ -0,0 +1,107 @@
+#include "pianoroll.h"
+#include "config.h"
+#include "layout.h"
+#include "leds.h"
+#include "midiclock.h"
+#include <string.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+// History ring. Each cell holds (channel + 1) of the note that painted it, or
+// 0 when empty. cols[head] is the live column still accumulating notes.
+static uint8_t cols[PANEL_WIDTH][PANEL_HEIGHT];
+static int head = 0;
+
+static uint32_t lastStepUs = 0;
+static int lastSixteenth = -1; // Last clock-synced step, -1 when free running
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// Map a MIDI note onto a row (0 = bottom)
+static int noteRow(int note) {
+  int row = (note - ROLL_LOW_NOTE) * PANEL_HEIGHT / ROLL_NOTE_SPAN;
+  if (row < 0)
+    return 0;
+  if (row >= PANEL_HEIGHT)
+    return PANEL_HEIGHT - 1;
+  return row;
+}
+
+// Move the ring origin by one column. Only the new column is written; older
+// columns stay where they are and shift on screen through the origin.
+static void step() {
+  head = (head + 1) % PANEL_WIDTH;
+  uint8_t *col = cols[head];
+  memset(col, 0, PANEL_HEIGHT);
+
+  // Held notes continue as bars into the new column
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    if (!channels[c].seen)
+      continue;
+    for (int n = 0; n < MAX_NOTES; n++) {
+      if (channels[c].notes[n].active)
+        col[noteRow(n)] = (uint8_t)(c + 1);
+    }
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void roll_init() { roll_reset(); }
+
+void roll_reset() {
+  memset(cols, 0, sizeof(cols));
+  head = 0;
+  lastSixteenth = -1;
+}
+
+void roll_noteOn(int channel, int note) {
+  if (channel < 0 || channel >= MAX_CHANNELS)
+    return;
+  if (note < 0 || note >= MAX_NOTES)
+    return;
+  cols[head][noteRow(note)] = (uint8_t)(channel + 1);
+}
+
+void roll_update(uint32_t now_us) {
+  // Tempo-synced: one column per sixteenth note, aligned to the beat
+  if (midiclock_running() && midiclock_locked(now_us)) {
+    int sixteenth = midiclock_beatPhase(now_us) >> 14;
+    if (sixteenth != lastSixteenth) {
+      if (lastSixteenth >= 0)
+        step();
+      lastSixteenth = sixteenth;
+    }
+    lastStepUs = now_us;
+    return;
+  }
+  lastSixteenth = -1;
+
+  // Free running. After a long gap only scroll one screen's worth.
+  if (now_us - lastStepUs > (uint32_t)PANEL_WIDTH * ROLL_STEP_US)
+    lastStepUs = now_us - ROLL_STEP_US;
+  while (now_us - lastStepUs >= ROLL_STEP_US) {
+    step();
+    lastStepUs += ROLL_STEP_US;
+  }
+}
+
+void roll_render() {
+  // Oldest column on the left, live column (head) on the right
+  for (int x = 0; x < PANEL_WIDTH; x++) {
+    const uint8_t *col = cols[(head + 1 + x) % PANEL_WIDTH];
+    for (int row = 0; row < PANEL_HEIGHT; row++) {
+      if (col[row] == 0)
+        continue;
+      // Cells hold channel + 1, matching the palette's channel slots
+      leds_setPixelIndex(x, PANEL_HEIGHT - 1 - row,
+                         PALETTE_CHANNEL_BASE - 1 + col[row]);
+    }
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef PIANOROLL_H
+#define PIANOROLL_H
+
+#include <stdint.h>
+
+// Scrolling piano-roll history.
+//
+// Time runs right-to-left across the panel and pitch bottom-to-top. History
+// lives in a circular buffer of PANEL_WIDTH columns; scrolling moves the ring
+// origin and writes one new column, and the origin is folded into the column
+// lookup at render time.
+
+// Clear history
+void roll_init();
+void roll_reset();
+
+// Record a note strike so short notes still paint at least one column
+void roll_noteOn(int channel, int note);
+
+// Advance the ring for elapsed time. Steps on sixteenth notes while a MIDI
+// clock is running, otherwise every ROLL_STEP_US.
+void roll_update(uint32_t now_us);
+
+// Paint the history into the framebuffer (does not clear or show)
+void roll_render();
+
+#endif // PIANOROLL_H
@@ -0,0 +1,76 @@
+#include "power.h"
+#include "config.h"
+#include "console.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/sync.h"
+#include "leds.h"
+#include "pico/stdlib.h"
+#include "telemetry.h"
+#include <cstdio>
+
+static uint64_t lastActivityUs = 0;
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// clk_sys from the USB PLL, system PLL off
+static void slowClocks() {
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                  CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ,
+                  USB_CLK_HZ);
+  pll_deinit(pll_sys);
+}
+
+// Restart the system PLL as the runtime set it up at boot
+static void fastClocks() {
+  pll_init(pll_sys, PLL_SYS_REFDIV, PLL_SYS_VCO_FREQ_HZ, PLL_SYS_POSTDIV1,
+           PLL_SYS_POSTDIV2);
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                  CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, SYS_CLK_HZ,
+                  SYS_CLK_HZ);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void power_init() {
+#if ENABLE_IDLE_POWERDOWN
+  clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                  USB_CLK_HZ, USB_CLK_HZ);
+#endif
+  lastActivityUs = time_us_64();
+}
+
+void power_activity() { lastActivityUs = time_us_64(); }
+
+bool power_idleDue(uint64_t now_us) {
+  return now_us - lastActivityUs >= IDLE_TIMEOUT_MS * 1000ull;
+}
+
+void power_sleep() {
+  printf("Power: idle\n");
+  leds_waitIdle(); // Let the black frame latch before PIO slows down
+  uint32_t bytes = telemetry_midiBytes();
+  slowClocks();
+
+  // Check with interrupts masked so a byte arriving just before WFI still
+  // wakes it (a pending interrupt ends WFI even while masked). The stdio_usb
+  // 1 ms timer ends WFI too, so this loops about once a millisecond.
+  while (true) {
+    uint32_t irq = save_and_disable_interrupts();
+    bool wake = telemetry_midiBytes() != bytes;
+    if (!wake)
+      __wfi();
+    restore_interrupts(irq);
+    if (wake || console_poll())
+      break;
+  }
+
+  fastClocks();
+  leds_reclock();
+  lastActivityUs = time_us_64();
+  printf("Power: wake\n");
+}
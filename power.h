@@ -0,0 +1,28 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+// Idle power-down.
+//
+// Once nothing has been played for IDLE_TIMEOUT_MS the main loop blanks the
+// LEDs and calls power_sleep(): the system PLL is stopped, clk_sys runs from
+// the USB PLL and the core waits in WFI. MIDI bytes (UART RX interrupt) or
+// console input over USB bring the clocks back. The stdio_usb 1 ms
+// background timer also ends each WFI, so the core wakes about once a
+// millisecond to check, still at the low clock.
+
+// With ENABLE_IDLE_POWERDOWN, move clk_peri onto the 48 MHz USB PLL. Call
+// first thing in main(), before any UART/SPI baud rate is set.
+void power_init();
+
+// Note activity: restarts the idle timeout
+void power_activity();
+
+// True once the idle timeout has passed
+bool power_idleDue(uint64_t now_us);
+
+// Lower the clocks and sleep until MIDI or USB input; returns at full speed
+void power_sleep();
+
+#endif // POWER_H
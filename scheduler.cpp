@@ -0,0 +1,160 @@
+#include "scheduler.h"
+#include "config.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/stdlib.h"
+#include <cstdio>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static Task tasks[SCHEDULER_MAX_TASKS];
+static int taskCount = 0;
+static int alarmNum = -1;
+
+static const uint64_t NO_DEADLINE = UINT64_MAX;
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+// Alarm IRQ: nothing to do but wake the core out of __wfe()
+static void alarmCallback(uint alarm) {
+  (void)alarm;
+  __sev();
+}
+
+static void runTask(Task &t, uint64_t now) {
+  uint64_t release = t.deadline_us;
+
+  uint32_t late = (uint32_t)(now - release);
+  if (late > t.max_late_us)
+    t.max_late_us = late;
+
+  // Advance from the release time (not from 'now') so periodic tasks do not
+  // accumulate drift. If we fell a whole period behind, drop the missed
+  // releases rather than running the task back-to-back to catch up.
+  if (t.period_us == 0) {
+    t.deadline_us = NO_DEADLINE;
+  } else {
+    t.deadline_us = release + t.period_us;
+    if (t.deadline_us <= now) {
+      t.skipped += (uint32_t)((now - release) / t.period_us);
+      t.deadline_us = now + t.period_us;
+    }
+  }
+
+  t.fn(now);
+
+  uint32_t elapsed = (uint32_t)(time_us_64() - now);
+  t.runs++;
+  t.last_us = elapsed;
+  if (elapsed > t.max_us)
+    t.max_us = elapsed;
+  if (elapsed > t.budget_us)
+    t.overruns++;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void scheduler_init() {
+  alarmNum = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(alarmNum, alarmCallback);
+}
+
+int scheduler_addTask(const char *name, TaskFn fn, uint8_t priority,
+                      uint32_t period_us, uint32_t budget_us) {
+  if (taskCount >= SCHEDULER_MAX_TASKS)
+    return -1;
+
+  Task &t = tasks[taskCount];
+  t = Task{};
+  t.name = name;
+  t.fn = fn;
+  t.priority = priority;
+  t.period_us = period_us;
+  t.budget_us = budget_us;
+  t.deadline_us = time_us_64();
+  return taskCount++;
+}
+
+void scheduler_setPeriod(int id, uint32_t period_us) {
+  if (id < 0 || id >= taskCount)
+    return;
+  tasks[id].period_us = period_us;
+}
+
+void scheduler_wakeAt(int id, uint64_t deadline_us) {
+  if (id < 0 || id >= taskCount)
+    return;
+  tasks[id].deadline_us = deadline_us;
+}
+
+void scheduler_resume() {
+  uint64_t now = time_us_64();
+  for (int i = 0; i < taskCount; i++) {
+    if (tasks[i].deadline_us != NO_DEADLINE)
+      tasks[i].deadline_us = now;
+  }
+}
+
+void scheduler_runOnce() {
+  uint64_t now = time_us_64();
+
+  // Pick the highest priority task whose deadline has passed, and remember
+  // the earliest future deadline in case nothing is due yet
+  Task *next = nullptr;
+  uint64_t earliest = NO_DEADLINE;
+  for (int i = 0; i < taskCount; i++) {
+    Task &t = tasks[i];
+    if (t.deadline_us <= now) {
+      if (next == nullptr || t.priority < next->priority)
+        next = &t;
+    } else if (t.deadline_us < earliest) {
+      earliest = t.deadline_us;
+    }
+  }
+
+  if (next != nullptr) {
+    runTask(*next, now);
+    return;
+  }
+
+  // Nothing due: sleep until the alarm (or any other interrupt) fires.
+  // hardware_alarm_set_target() returns true if the target already passed.
+  if (earliest == NO_DEADLINE) {
+    __wfe();
+  } else if (!hardware_alarm_set_target(alarmNum,
+                                        from_us_since_boot(earliest))) {
+    __wfe();
+  }
+}
+
+int scheduler_taskCount() { return taskCount; }
+
+const Task *scheduler_getTask(int id) {
+  if (id < 0 || id >= taskCount)
+    return nullptr;
+  return &tasks[id];
+}
+
+void scheduler_clearPeaks() {
+  for (int i = 0; i < taskCount; i++) {
+    tasks[i].max_us = 0;
+    tasks[i].max_late_us = 0;
+  }
+}
+
+void scheduler_printStats() {
+  printf("Task        runs   over  skip  last_us  max_us  late_us\n");
+  for (int i = 0; i < taskCount; i++) {
+    const Task &t = tasks[i];
+    printf("%-10s %6lu %6lu %5lu %8lu %7lu %8lu\n", t.name,
+           (unsigned long)t.runs, (unsigned long)t.overruns,
+           (unsigned long)t.skipped, (unsigned long)t.last_us,
+           (unsigned long)t.max_us, (unsigned long)t.max_late_us);
+  }
+}
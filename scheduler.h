@@ -0,0 +1,65 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// ============================================================================
+// Data Structures
+// ============================================================================
+
+// Task body. Receives the time (us since boot) at which it was dispatched.
+typedef void (*TaskFn)(uint64_t now_us);
+
+struct Task {
+  const char *name;
+  TaskFn fn;
+  uint8_t priority;     // Lower value wins when several tasks are due
+  uint32_t period_us;   // Release interval (0 = one-shot, see scheduler_wakeAt)
+  uint32_t budget_us;   // Declared worst-case run time
+  uint64_t deadline_us; // Next release time
+
+  // Statistics (read by telemetry)
+  uint32_t runs;        // Completed runs
+  uint32_t overruns;    // Runs that took longer than budget_us
+  uint32_t skipped;     // Releases dropped because the task fell behind
+  uint32_t last_us;     // Duration of the most recent run
+  uint32_t max_us;      // Longest run seen
+  uint32_t max_late_us; // Worst dispatch latency past the deadline
+};
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+// Claim the hardware alarm used to wake the core for the next deadline
+void scheduler_init();
+
+// Register a periodic task. Returns its id, or -1 if the table is full.
+// The first release is immediate.
+int scheduler_addTask(const char *name, TaskFn fn, uint8_t priority,
+                      uint32_t period_us, uint32_t budget_us);
+
+// Change a task's release interval (takes effect from its next release)
+void scheduler_setPeriod(int id, uint32_t period_us);
+
+// Release a task at an absolute time (us since boot), overriding its period
+void scheduler_wakeAt(int id, uint64_t deadline_us);
+
+// Release every task now after the core was stopped for a while (idle
+// power-down). The gap is not counted as skipped releases.
+void scheduler_resume();
+
+// Dispatch the most urgent due task, or sleep until the next deadline
+void scheduler_runOnce();
+
+// Task table access for telemetry
+int scheduler_taskCount();
+const Task *scheduler_getTask(int id);
+
+// Clear the worst-case figures (max_us, max_late_us); counts are kept
+void scheduler_clearPeaks();
+
+// Print per-task timing statistics over stdio
+void scheduler_printStats();
+
+#endif // SCHEDULER_H
@@ -0,0 +1,399 @@
+#include "smfplayer.h"
+#include "config.h"
+#include "console.h"
+#include "hotpath.h"
+#include "midiparser.h"
+#include "midithru.h"
+#include "pico/stdlib.h"
+#include "telemetry.h"
+#include <cstdio>
+#include <string.h>
+
+#if ENABLE_SHOW
+
+// The show sits right below the capture region at the end of flash
+static const uint32_t FLASH_OFFSET =
+    PICO_FLASH_SIZE_BYTES - CAPTURE_FLASH_BYTES - SHOW_FLASH_BYTES;
+static const uint8_t *const REGION = (const uint8_t *)(XIP_BASE + FLASH_OFFSET);
+static const uint8_t *const REGION_END = REGION + SHOW_FLASH_BYTES;
+
+// Dense passages are spread over several task runs
+static const int MAX_EVENTS_PER_RUN = 64;
+
+extern char __flash_binary_end; // From the linker script
+
+// ============================================================================
+// State
+// ============================================================================
+
+struct Track {
+  const uint8_t *p;   // Next byte to read (in flash)
+  const uint8_t *end; // End of the MTrk chunk
+  uint32_t tick;      // Absolute tick of the event at p
+  uint8_t running;    // Running status within the track
+};
+
+static Track tracks[SHOW_MAX_TRACKS];
+static uint8_t heap[SHOW_MAX_TRACKS]; // Track indices, next event first
+static int heapSize = 0;
+
+static const uint8_t *nextFile = nullptr; // Where the current file ends
+
+// Tick -> time. The tempo map is followed as the events play: every tempo
+// change starts a new segment at (tickBase, usBase).
+static uint32_t division = 96;  // Ticks per quarter note (per second: SMPTE)
+static uint32_t tempo = 500000; // us per quarter note
+static bool smpte = false;      // Fixed tick length, tempo events ignored
+static uint32_t tickBase = 0;
+static uint64_t usBase = 0;     // Since fileStartUs
+static uint64_t fileStartUs = 0;
+
+static bool available = false; // A valid file was found at boot
+static bool playing = false;
+static uint32_t lastRxMessages = 0;
+static uint64_t lastLiveUs = 0;
+
+static MidiParser parser;
+static uint8_t held[16][128 / 8]; // Notes the show has turned on, by channel
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+// Variable-length quantity. Returns false at the end of the track.
+static bool readVlq(Track &t, uint32_t *out) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4 && t.p < t.end; i++) {
+    uint8_t b = *t.p++;
+    v = (v << 7) | (b & 0x7F);
+    if (!(b & 0x80)) {
+      *out = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint64_t tickToUs(uint32_t tick) {
+  return usBase + (uint64_t)(tick - tickBase) * tempo / division;
+}
+
+// ============================================================================
+// Track Heap
+// ============================================================================
+
+// Ties go to the lower track so simultaneous events keep file order
+static bool earlier(int a, int b) {
+  return tracks[a].tick < tracks[b].tick ||
+         (tracks[a].tick == tracks[b].tick && a < b);
+}
+
+static void siftUp(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!earlier(heap[i], heap[parent]))
+      break;
+    uint8_t tmp = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+static void siftDown(int i) {
+  while (true) {
+    int least = i;
+    int l = 2 * i + 1, r = 2 * i + 2;
+    if (l < heapSize && earlier(heap[l], heap[least]))
+      least = l;
+    if (r < heapSize && earlier(heap[r], heap[least]))
+      least = r;
+    if (least == i)
+      break;
+    uint8_t tmp = heap[i];
+    heap[i] = heap[least];
+    heap[least] = tmp;
+    i = least;
+  }
+}
+
+// Read the delta time in front of the track's next event
+static bool advance(int i) {
+  uint32_t delta;
+  if (!readVlq(tracks[i], &delta))
+    return false;
+  tracks[i].tick += delta;
+  return true;
+}
+
+// ============================================================================
+// File Parsing
+// ============================================================================
+
+// Set up the cursors for the file whose MThd is at p
+static bool openFile(const uint8_t *p) {
+  if (p == nullptr || REGION_END - p < 14 || memcmp(p, "MThd", 4) != 0)
+    return false;
+  uint32_t headerLen = be32(p + 4);
+  uint16_t format = be16(p + 8);
+  uint16_t trackCount = be16(p + 10);
+  uint16_t div = be16(p + 12);
+  if (headerLen < 6 || headerLen > (uint32_t)(REGION_END - p) - 8 ||
+      format > 1 || div == 0)
+    return false;
+
+  if (div & 0x8000) {
+    // SMPTE: -frames per second in the high byte, ticks per frame below
+    smpte = true;
+    division = (uint32_t)(-(int8_t)(div >> 8)) * (div & 0xFF);
+    tempo = 1000000;
+  } else {
+    smpte = false;
+    division = div;
+    tempo = 500000; // 120 BPM until the first tempo event
+  }
+  if (division == 0)
+    return false;
+  tickBase = 0;
+  usBase = 0;
+
+  heapSize = 0;
+  int found = 0;
+  const uint8_t *c = p + 8 + headerLen;
+  while (found < trackCount) {
+    if (REGION_END - c < 8)
+      return false;
+    uint32_t len = be32(c + 4);
+    const uint8_t *body = c + 8;
+    if (len > (uint32_t)(REGION_END - body))
+      return false;
+
+    // Unknown chunk types are skipped, as the format requires
+    if (memcmp(c, "MTrk", 4) == 0) {
+      if (found < SHOW_MAX_TRACKS) {
+        tracks[found] = {body, body + len, 0, 0};
+        if (advance(found)) {
+          heap[heapSize++] = (uint8_t)found;
+          siftUp(heapSize - 1);
+        }
+      } else if (found == SHOW_MAX_TRACKS) {
+        printf("Show: only the first %d tracks are played\n",
+               SHOW_MAX_TRACKS);
+      }
+      found++;
+    }
+    c = body + len;
+  }
+  nextFile = c;
+  return true;
+}
+
+// ============================================================================
+// Playback
+// ============================================================================
+
+// Same dispatch as live input: the bytes go through a parser
+static void send(const uint8_t *msg, int len, uint64_t now) {
+  uint8_t type = msg[0] & 0xF0;
+  if (len == 3 && (type == 0x80 || type == 0x90)) {
+    uint8_t &bits = held[msg[0] & 0x0F][msg[1] >> 3];
+    uint8_t bit = (uint8_t)(1u << (msg[1] & 7));
+    if (type == 0x90 && msg[2] > 0)
+      bits |= bit;
+    else
+      bits &= (uint8_t)~bit;
+  }
+  for (int i = 0; i < len; i++) {
+    midiparser_processByte(&parser, msg[i], (uint32_t)now);
+  }
+  midithru_send(msg, len); // Merge mode only
+}
+
+// Note Off for every note the show left on. Only those: All Notes Off would
+// also clear live notes, here and on the gear behind the merge output.
+static void releaseNotes() {
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    for (uint8_t note = 0; note < 128; note++) {
+      if ((held[ch][note >> 3] >> (note & 7)) & 1) {
+        uint8_t msg[3] = {(uint8_t)(0x80 | ch), note, 0};
+        send(msg, 3, time_us_64());
+      }
+    }
+  }
+}
+
+// Play the event at the track cursor. Returns false when the track ends.
+static bool playEvent(Track &t, uint64_t now) {
+  if (t.p >= t.end)
+    return false;
+  uint8_t status = *t.p;
+  if (status & 0x80)
+    t.p++;
+  else
+    status = t.running;
+
+  if (status >= 0x80 && status < 0xF0) {
+    t.running = status;
+    int n = (status & 0xE0) == 0xC0 ? 1 : 2; // Program change, pressure
+    if (t.end - t.p < n)
+      return false;
+    uint8_t msg[3] = {status, t.p[0], n > 1 ? t.p[1] : (uint8_t)0};
+    t.p += n;
+    send(msg, 1 + n, now);
+    return true;
+  }
+
+  // Meta and SysEx events cancel running status
+  t.running = 0;
+  if (status == 0xFF) {
+    if (t.p >= t.end)
+      return false;
+    uint8_t type = *t.p++;
+    uint32_t len;
+    if (!readVlq(t, &len) || len > (uint32_t)(t.end - t.p))
+      return false;
+    const uint8_t *d = t.p;
+    t.p += len;
+
+    if (type == 0x2F) // End of track
+      return false;
+    if (type == 0x51 && len == 3 && !smpte) {
+      usBase = tickToUs(t.tick);
+      tickBase = t.tick;
+      tempo = ((uint32_t)d[0] << 16) | ((uint32_t)d[1] << 8) | d[2];
+    }
+    return true;
+  }
+
+  if (status == 0xF0 || status == 0xF7) {
+    // SysEx is not played; skip its length-prefixed body
+    uint32_t len;
+    if (!readVlq(t, &len) || len > (uint32_t)(t.end - t.p))
+      return false;
+    t.p += len;
+    return true;
+  }
+  return false; // Data byte with no running status: corrupt track
+}
+
+// Next file in the region, wrapping to the first one. Notes a file left
+// hanging are released first.
+static void nextShowFile(uint64_t now) {
+  releaseNotes();
+  if (!openFile(nextFile) && !openFile(REGION)) {
+    printf("Show: no playable file\n");
+    playing = false;
+    return;
+  }
+  fileStartUs = now + SHOW_GAP_MS * 1000ull;
+}
+
+static void showCommand(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "play") == 0) {
+    smfplayer_start();
+  } else if (argc > 1 && strcmp(argv[1], "stop") == 0) {
+    smfplayer_stop();
+  }
+  printf("Show: %s, %s (region 0x%08lx, %d KB)\n",
+         available ? "loaded" : "empty", playing ? "playing" : "stopped",
+         (unsigned long)(XIP_BASE + FLASH_OFFSET), SHOW_FLASH_BYTES / 1024);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void smfplayer_init() {
+  midiparser_init(&parser, 0, false);
+  lastLiveUs = time_us_64();
+
+  if ((uintptr_t)&__flash_binary_end > XIP_BASE + FLASH_OFFSET) {
+    printf("Show: flash region overlaps the firmware\n");
+  } else {
+    available = openFile(REGION);
+  }
+  printf("Show: %s at 0x%08lx\n", available ? "found" : "nothing",
+         (unsigned long)(XIP_BASE + FLASH_OFFSET));
+  console_addCommand("show", showCommand, "Built-in MIDI show: play | stop");
+}
+
+void smfplayer_start() {
+  if (!available)
+    return;
+  midiparser_reset(&parser);
+  playing = openFile(REGION);
+  fileStartUs = time_us_64();
+  printf("Show: playing\n");
+}
+
+void smfplayer_stop() {
+  if (!playing)
+    return;
+  playing = false;
+  heapSize = 0;
+  releaseNotes();
+  printf("Show: stopped\n");
+}
+
+bool HOT_FUNC(smfplayer_playing)() { return playing; }
+
+uint64_t smfplayer_service(uint64_t now_us) {
+  uint64_t poll = now_us + SHOW_INTERVAL_US;
+
+  // Live MIDI always wins over the show. Only channel messages count: a
+  // sequencer that is just sending clock or active sensing is not playing.
+  // midi_poll() has normally stopped the show already; this restarts the
+  // autostart wait.
+  uint32_t rx = telemetry_midiMessages();
+  if (rx != lastRxMessages) {
+    lastRxMessages = rx;
+    lastLiveUs = now_us;
+    smfplayer_stop();
+    return poll;
+  }
+  if (!playing) {
+    if (available && now_us - lastLiveUs >= SHOW_AUTOSTART_MS * 1000ull)
+      smfplayer_start();
+    if (!playing)
+      return poll;
+  }
+
+  for (int n = 0; n < MAX_EVENTS_PER_RUN && heapSize > 0; n++) {
+    int i = heap[0];
+    if (fileStartUs + tickToUs(tracks[i].tick) > now_us)
+      break;
+    if (playEvent(tracks[i], now_us) && advance(i)) {
+      siftDown(0);
+    } else {
+      heap[0] = heap[--heapSize]; // Track finished
+      siftDown(0);
+    }
+  }
+
+  if (heapSize == 0) {
+    nextShowFile(now_us);
+    if (!playing || heapSize == 0)
+      return poll;
+  }
+  uint64_t due = fileStartUs + tickToUs(tracks[heap[0]].tick);
+  return due < poll ? due : poll;
+}
+
+#else
+
+void smfplayer_init() {}
+void smfplayer_start() {}
+void smfplayer_stop() {}
+bool smfplayer_playing() { return false; }
+uint64_t smfplayer_service(uint64_t now_us) {
+  return now_us + SHOW_INTERVAL_US;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SMFPLAYER_H
+#define SMFPLAYER_H
+
+#include <stdint.h>
+
+// Standard MIDI File player for standalone installs.
+//
+// Plays the type 0/1 files stored back to back in the show flash region
+// (SHOW_FLASH_BYTES below the capture region), looping over them. Tracks
+// are read in place from XIP: each has a cursor, and the cursors are merged
+// by a small min-heap on their next event tick. Due events go through a
+// MidiParser of their own into the usual onNoteOn()/onNoteOff() path, and
+// to the MIDI output in merge mode.
+//
+// Load a show with e.g.
+//   cat a.mid b.mid > show.bin
+//   picotool load -o <address printed at boot> show.bin
+
+// Check the flash region, register the task and the 'show' command
+void smfplayer_init();
+
+// Start from the first file / stop. Stopping sends Note Off for the notes
+// the show is holding, and nothing else.
+void smfplayer_start();
+void smfplayer_stop();
+
+bool smfplayer_playing();
+
+// Play the events that are due, start or stop on live input. Returns when
+// it needs to run next (us since boot).
+uint64_t smfplayer_service(uint64_t now_us);
+
+#endif // SMFPLAYER_H
@@ -0,0 +1,123 @@
+#include "telemetry.h"
+#include "config.h"
+#include "console.h"
+#include "midithru.h"
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "scheduler.h"
+#include <cstdio>
+#include <string.h>
+
+TelemetryCounters telemetry;
+
+// Rate gauges are computed over the interval between telemetry_update calls
+static uint32_t windowStartUs = 0;
+static uint32_t windowFrames = 0;
+static uint32_t windowBytes[TELEMETRY_PORTS];
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+static void fillSnapshot(TelemetrySnapshot *s) {
+  pico_unique_board_id_t id;
+  pico_get_unique_board_id(&id);
+
+  s->magic = TELEMETRY_MAGIC;
+  s->version = TELEMETRY_VERSION;
+  s->size = sizeof(TelemetrySnapshot);
+  memcpy(s->boardId, id.id, sizeof(s->boardId));
+  s->uptimeMs = to_ms_since_boot(get_absolute_time());
+  memcpy(&s->counters, &telemetry, sizeof(telemetry));
+}
+
+static void printText() {
+  const TelemetryCounters &t = telemetry;
+  for (int i = 0; i < MIDI_PORTS; i++) {
+    const TelemetryPort &p = t.ports[i];
+    printf("MIDI%d: %lu bytes (%lu/s), %lu msgs, overrun %lu, framing %lu, "
+           "break %lu, ring drops %lu, resyncs %lu\n",
+           i + 1, (unsigned long)p.rxBytes, (unsigned long)p.bytesPerSec,
+           (unsigned long)p.messages, (unsigned long)p.overrunErrors,
+           (unsigned long)p.framingErrors, (unsigned long)p.breakErrors,
+           (unsigned long)p.ringDrops, (unsigned long)p.parserResyncs);
+  }
+  printf("Frames: %lu (%lu.%02lu fps), skipped %lu, overruns %lu\n",
+         (unsigned long)t.frames, (unsigned long)(t.fpsX100 / 100),
+         (unsigned long)(t.fpsX100 % 100), (unsigned long)t.framesSkipped,
+         (unsigned long)t.frameOverruns);
+  printf("Render %lu us (max %lu), transmit %lu us, events/frame %lu "
+         "(max %lu)\n",
+         (unsigned long)t.renderUs, (unsigned long)t.renderMaxUs,
+         (unsigned long)t.transmitUs, (unsigned long)t.eventsPerFrame,
+         (unsigned long)t.eventsPerFrameMax);
+  printf("Thru drops %lu, task overruns %lu\n", (unsigned long)t.thruDrops,
+         (unsigned long)t.taskOverruns);
+}
+
+static void telemetryCommand(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "bin") == 0) {
+    TelemetrySnapshot s;
+    fillSnapshot(&s);
+    printf("TELEMETRY %u\n", (unsigned)sizeof(s));
+    console_writeRaw(&s, sizeof(s));
+    printf("\n");
+  } else if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+    telemetry.renderMaxUs = 0;
+    telemetry.eventsPerFrameMax = 0;
+    printf("Telemetry: peaks cleared\n");
+  } else {
+    printText();
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void telemetry_init() {
+  console_addCommand("telemetry", telemetryCommand,
+                     "Health counters: [bin] snapshot | clear peaks");
+}
+
+uint32_t telemetry_midiBytes() {
+  uint32_t total = 0;
+  for (int i = 0; i < TELEMETRY_PORTS; i++) {
+    total += telemetry.ports[i].rxBytes;
+  }
+  return total;
+}
+
+uint32_t telemetry_midiMessages() {
+  uint32_t total = 0;
+  for (int i = 0; i < TELEMETRY_PORTS; i++) {
+    total += telemetry.ports[i].messages;
+  }
+  return total;
+}
+
+void telemetry_update(uint32_t now_us) {
+  uint32_t dt = now_us - windowStartUs;
+  if (dt == 0)
+    return;
+
+  uint32_t frames = telemetry.frames;
+  telemetry.fpsX100 =
+      (uint32_t)((uint64_t)(frames - windowFrames) * 100000000ull / dt);
+  windowFrames = frames;
+
+  for (int i = 0; i < TELEMETRY_PORTS; i++) {
+    uint32_t bytes = telemetry.ports[i].rxBytes;
+    telemetry.ports[i].bytesPerSec =
+        (uint32_t)((uint64_t)(bytes - windowBytes[i]) * 1000000ull / dt);
+    windowBytes[i] = bytes;
+  }
+  windowStartUs = now_us;
+
+  uint32_t overruns = 0;
+  for (int i = 0; i < scheduler_taskCount(); i++) {
+    overruns += scheduler_getTask(i)->overruns;
+  }
+  telemetry.taskOverruns = overruns;
+  telemetry.thruDrops = midithru_dropped();
+}
@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// Runtime health counters.
+//
+// Every field has exactly one writer (an interrupt handler or one task), so
+// updates are plain aligned 32-bit stores with no locking. Readers may see a
+// snapshot that is a few microseconds stale, never a torn value.
+//
+// 'telemetry bin' on the console sends a TelemetrySnapshot; the layout is
+// fixed (little endian) so scripts can poll many units, see
+// tools/telemetry_poll.py.
+
+#define TELEMETRY_MAGIC 0x4D4C4554u // "TELM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PORTS 2 // Fixed so the snapshot layout never changes
+
+// Per DIN input
+struct TelemetryPort {
+  uint32_t rxBytes;       // Bytes received (UART RX interrupt)
+  uint32_t overrunErrors; // UART overruns: bytes lost in hardware
+  uint32_t framingErrors; // Bad stop bit (byte discarded)
+  uint32_t breakErrors;   // Line held low (byte discarded)
+  uint32_t ringDrops;     // Receive ring full: bytes lost in software
+  uint32_t parserResyncs; // Messages cut short by a new status byte
+  uint32_t messages;      // Complete channel messages parsed
+  uint32_t bytesPerSec;   // Gauge: rx rate over the last window
+};
+
+struct TelemetryCounters {
+  TelemetryPort ports[TELEMETRY_PORTS];
+
+  // Frame pipeline (written by the frame task)
+  uint32_t frames;
+  uint32_t framesSkipped;     // Frame releases dropped by the scheduler
+  uint32_t frameOverruns;     // Frame task runs over budget
+  uint32_t renderUs;          // Gauge: last frame's draw time
+  uint32_t renderMaxUs;
+  uint32_t transmitUs;        // Gauge: LED transfer + latch time
+  uint32_t eventsPerFrame;    // Gauge: note on/off since the previous frame
+  uint32_t eventsPerFrameMax;
+  uint32_t fpsX100;           // Gauge: frames per second over the last window
+
+  uint32_t thruDrops;    // MIDI output bytes/messages discarded
+  uint32_t taskOverruns; // All tasks
+};
+
+struct TelemetrySnapshot {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size; // sizeof(TelemetrySnapshot)
+  uint8_t boardId[8];
+  uint32_t uptimeMs;
+  TelemetryCounters counters;
+};
+
+static_assert(sizeof(TelemetrySnapshot) == 20 + 4 * (8 * TELEMETRY_PORTS + 11),
+              "Telemetry snapshot must stay packed");
+
+extern TelemetryCounters telemetry;
+
+// Register the console command
+void telemetry_init();
+
+// Bytes received on all MIDI inputs so far (any change means live input)
+uint32_t telemetry_midiBytes();
+
+// Channel messages parsed from all MIDI inputs so far. Unlike the byte
+// count, clock and active sensing from an idle device do not move it.
+uint32_t telemetry_midiMessages();
+
+// Recompute the rate gauges (call periodically)
+void telemetry_update(uint32_t now_us);
+
+#endif // TELEMETRY_H
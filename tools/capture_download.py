@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""Download a MIDI capture from the device over USB serial.
+
+Usage: capture_download.py /dev/ttyACM0 capture.bin [--flash]
+
+Sends 'capture dump' (or 'capture dump flash' for a capture stored in flash
+by an earlier boot) and saves the binary block that follows. Replay it with
+tools/capture_replay.cpp. Requires pyserial.
+"""
+
+import sys
+
+import serial
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if len(args) != 2:
+        sys.exit(__doc__)
+    port, out = args
+    cmd = "capture dump flash\n" if "--flash" in sys.argv else "capture dump\n"
+
+    with serial.Serial(port, timeout=5) as ser:
+        ser.reset_input_buffer()
+        ser.write(cmd.encode())
+        while True:
+            line = ser.readline()
+            if not line:
+                sys.exit("No response from device")
+            if line.startswith(b"CAPTURE "):
+                size = int(line.split()[1])
+                break
+        data = ser.read(size)
+        if len(data) != size:
+            sys.exit("Short read: %d of %d bytes" % (len(data), size))
+
+    with open(out, "wb") as f:
+        f.write(data)
+    print("Saved %d bytes to %s" % (size, out))
+
+
+if __name__ == "__main__":
+    main()
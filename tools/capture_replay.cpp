@@ -0,0 +1,111 @@
+// Replay a MIDI capture through the firmware's parser on a host.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -I. -o capture_replay tools/capture_replay.cpp
+//       midiparser.cpp midiclock.cpp
+//
+// Usage: capture_replay capture.bin
+//
+// Every captured byte is fed to midiparser_processByte() with its original
+// ingest timestamp, so the parser and clock tracker see exactly what the
+// device saw. Each resulting event is printed as one line; diff two runs to
+// check a parser change against recorded traffic.
+
+#include "capture.h"
+#include "config.h"
+#include "midiclock.h"
+#include "midiparser.h"
+#include <cstdio>
+
+static uint32_t now_us = 0;
+static uint8_t now_port = 0;
+
+void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+  printf("%10lu p%u note-on  ch%-2u %3u %3u\n", (unsigned long)now_us,
+         now_port, channel % 16 + 1, note, velocity);
+}
+
+void onNoteOff(uint8_t channel, uint8_t note) {
+  printf("%10lu p%u note-off ch%-2u %3u\n", (unsigned long)now_us, now_port,
+         channel % 16 + 1, note);
+}
+
+void onPitchBend(uint8_t channel, int16_t bend) {
+  printf("%10lu p%u bend     ch%-2u %5d\n", (unsigned long)now_us, now_port,
+         channel % 16 + 1, bend);
+}
+
+void onChannelPressure(uint8_t channel, uint8_t pressure) {
+  printf("%10lu p%u pressure ch%-2u %3u\n", (unsigned long)now_us, now_port,
+         channel % 16 + 1, pressure);
+}
+
+void onParameter(uint8_t channel, uint16_t rpn, uint8_t value) {
+  printf("%10lu p%u rpn      ch%-2u %3u %3u\n", (unsigned long)now_us,
+         now_port, channel % 16 + 1, rpn, value);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s capture.bin\n", argv[0]);
+    return 2;
+  }
+  FILE *f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  CaptureHeader hdr;
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != CAPTURE_MAGIC ||
+      hdr.version != CAPTURE_VERSION || hdr.entrySize != sizeof(CaptureEntry)) {
+    fprintf(stderr, "%s: not a version %d capture\n", argv[1],
+            CAPTURE_VERSION);
+    return 1;
+  }
+  printf("# %lu entries, %lu lost on the device\n", (unsigned long)hdr.count,
+         (unsigned long)hdr.lost);
+
+  // One parser per input port, as on the device
+  MidiParser parsers[MIDI_PORTS];
+  for (int i = 0; i < MIDI_PORTS; i++) {
+    midiparser_init(&parsers[i], i * 16, i == MIDI_CLOCK_PORT);
+  }
+  midiclock_reset();
+
+  bool running = false;
+  uint32_t bpm = 0;
+  CaptureEntry e;
+  for (uint32_t i = 0; i < hdr.count; i++) {
+    if (fread(&e, sizeof(e), 1, f) != 1) {
+      fprintf(stderr, "%s: truncated after %lu entries\n", argv[1],
+              (unsigned long)i);
+      return 1;
+    }
+    if (e.flags & CAPTURE_FLAG_GAP)
+      printf("%10lu -- gap --\n", (unsigned long)e.t_us);
+
+    if (e.port >= MIDI_PORTS) {
+      fprintf(stderr, "%s: entry %lu is from port %u\n", argv[1],
+              (unsigned long)i, e.port);
+      return 1;
+    }
+    now_us = e.t_us;
+    now_port = e.port;
+    midiparser_processByte(&parsers[e.port], e.b, e.t_us);
+
+    if (midiclock_running() != running) {
+      running = midiclock_running();
+      printf("%10lu transport %s\n", (unsigned long)now_us,
+             running ? "start" : "stop");
+    }
+    uint32_t b = midiclock_bpmX100() / 100;
+    if (b != bpm) {
+      bpm = b;
+      printf("%10lu bpm %lu\n", (unsigned long)now_us, (unsigned long)bpm);
+    }
+  }
+
+  fclose(f);
+  return 0;
+}
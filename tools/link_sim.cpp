@@ -0,0 +1,495 @@
+// Run a display link master and its followers in one host process.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -I. -o link_sim tools/link_sim.cpp
+//
+// Usage: link_sim [frames] [seed]
+//
+// Random MIDI (notes, pitch bend and pressure on both ports, MPE zone
+// changes, the odd layout reset)
+// goes through the firmware's parser into the master's layout. Every frame
+// the master's linksync output is carried over an in-memory byte pipe to
+// three followers, each with its own copy of the layout code:
+//
+//   follower 1  gets every byte; must match after every complete frame
+//   follower 2  loses bytes during two windows; must match again within
+//               two refresh rounds of each (see linksync.h)
+//   follower 3  joins mid-stream; must match within one refresh round of
+//               MAX_CHANNELS * LINK_REFRESH_FRAMES frames
+//
+// "Match" means the tiles the follower draws in its own slice, the MPE
+// expression (bend and level) of every lit note, the active note bitmaps of
+// every channel, the set of channels in use (so note table slots cannot
+// leak) and the PRESENT sequence number are the master's.
+// Exits with status 1 on the first mismatch.
+
+#include "config.h"
+
+// Four boards, and this process plays the master (linksync.cpp)
+#undef LINK_ROLE
+#define LINK_ROLE LINK_ROLE_MASTER
+#undef LINK_NODE_COUNT
+#define LINK_NODE_COUNT 4
+
+#include "bsp.h"
+#include "hotpath.h"
+#include "layout.h"
+#include "link.h"
+#include "linkproto.h"
+#include "linksync.h"
+#include "midi.h"
+#include "midiclock.h"
+#include "midiparser.h"
+#include "mpe.h"
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsp.cpp"
+#include "linkproto.cpp"
+#include "midiclock.cpp"
+#include "midiparser.cpp"
+
+uint8_t global_brightness = 255;
+
+// ============================================================================
+// Boards
+// ============================================================================
+
+// Each board includes the layout and sync code into a namespace of its own,
+// so it gets private state. The declarations come first so calls inside the
+// board bind to its own copy rather than the global prototypes.
+#define BOARD_API                                                              \
+  void layout_init();                                                          \
+  void layout_reset();                                                         \
+  void registerChannel(int channel);                                           \
+  void registerNote(int channel, int note);                                    \
+  void setNoteActive(int channel, int note, bool active);                      \
+  void layout_removeChannel(int channel);                                      \
+  bool layout_takeDamage(Rect *out);                                           \
+  void layout_setChannel(int channel, uint32_t color, Rect bounds);            \
+  void layout_setNote(int channel, int note, Rect bounds);                     \
+  void layout_setActiveNotes(int channel, const uint8_t *bitmap);              \
+  void linksync_masterReset();                                                 \
+  int linksync_masterFrame(uint8_t *out, int cap, uint8_t brightness,          \
+                           uint8_t mode, uint32_t level, uint32_t fade_us);    \
+  bool linksync_masterBacklog();                                               \
+  void linksync_apply(const LinkPacket &pkt);                                  \
+  void onLinkPresent(uint8_t brightness, uint8_t mode, uint32_t level,         \
+                     uint32_t fade_us);                                        \
+  void mpe_init();                                                             \
+  int mpe_noteOn(int channel, int note);                                       \
+  bool mpe_noteOff(int channel, int note, int *tileChannel);                   \
+  void mpe_pitchBend(int channel, int16_t bend);                               \
+  void mpe_pressure(int channel, uint8_t pressure);                            \
+  void mpe_parameter(int channel, uint16_t rpn, uint8_t value);                \
+  bool mpe_expression(int tileChannel, int note, int32_t *bend,                \
+                      uint32_t *level);                                        \
+  void mpe_getChannel(int channel, MpeChannelState *out);                      \
+  void mpe_setChannel(int channel, const MpeChannelState &s);
+
+// Calls that pass a Rect, LinkPacket or MpeChannelState would also find the
+// global
+// prototypes through argument-dependent lookup, so those functions get a
+// per-board name as well
+#define BOARD_NAME2(board, fn) board##_##fn
+#define BOARD_NAME(board, fn) BOARD_NAME2(board, fn)
+#define layout_takeDamage BOARD_NAME(BOARD, layout_takeDamage)
+#define layout_setChannel BOARD_NAME(BOARD, layout_setChannel)
+#define layout_setNote BOARD_NAME(BOARD, layout_setNote)
+#define linksync_apply BOARD_NAME(BOARD, linksync_apply)
+#define mpe_getChannel BOARD_NAME(BOARD, mpe_getChannel)
+#define mpe_setChannel BOARD_NAME(BOARD, mpe_setChannel)
+
+// The boards' own diagnostics would drown the report
+#define printf(...) ((void)0)
+
+#define BOARD master
+namespace master {
+BOARD_API
+#include "layout.cpp"
+#include "linksync.cpp"
+#include "mpe.cpp"
+void onLinkPresent(uint8_t, uint8_t, uint32_t, uint32_t) {}
+} // namespace master
+
+static const int FOLLOWERS = LINK_NODE_COUNT - 1;
+static int presents[FOLLOWERS + 1]; // PRESENT packets applied, by board
+static uint8_t modes[FOLLOWERS + 1]; // Visualization mode of the last one
+
+#undef BOARD
+#define BOARD f1
+namespace f1 {
+BOARD_API
+#include "layout.cpp"
+#include "linksync.cpp"
+#include "mpe.cpp"
+void onLinkPresent(uint8_t, uint8_t mode, uint32_t, uint32_t) {
+  presents[1]++;
+  modes[1] = mode;
+}
+} // namespace f1
+
+#undef BOARD
+#define BOARD f2
+namespace f2 {
+BOARD_API
+#include "layout.cpp"
+#include "linksync.cpp"
+#include "mpe.cpp"
+void onLinkPresent(uint8_t, uint8_t mode, uint32_t, uint32_t) {
+  presents[2]++;
+  modes[2] = mode;
+}
+} // namespace f2
+
+#undef BOARD
+#define BOARD f3
+namespace f3 {
+BOARD_API
+#include "layout.cpp"
+#include "linksync.cpp"
+#include "mpe.cpp"
+void onLinkPresent(uint8_t, uint8_t mode, uint32_t, uint32_t) {
+  presents[3]++;
+  modes[3] = mode;
+}
+} // namespace f3
+
+#undef BOARD
+#undef layout_takeDamage
+#undef layout_setChannel
+#undef layout_setNote
+#undef linksync_apply
+#undef mpe_getChannel
+#undef mpe_setChannel
+#undef printf
+
+// ============================================================================
+// MIDI Callbacks (master)
+// ============================================================================
+
+// As in main.cpp, minus rendering
+void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
+  (void)velocity;
+  int tile = master::mpe_noteOn(channel, note);
+  master::registerChannel(tile);
+  master::registerNote(tile, note);
+  master::setNoteActive(tile, note, true);
+}
+
+void onNoteOff(uint8_t channel, uint8_t note) {
+  int tile;
+  if (master::mpe_noteOff(channel, note, &tile) && tile < MAX_CHANNELS)
+    master::setNoteActive(tile, note, false);
+}
+
+void onPitchBend(uint8_t channel, int16_t bend) {
+  master::mpe_pitchBend(channel, bend);
+}
+
+void onChannelPressure(uint8_t channel, uint8_t pressure) {
+  master::mpe_pressure(channel, pressure);
+}
+
+void onParameter(uint8_t channel, uint16_t rpn, uint8_t value) {
+  master::mpe_parameter(channel, rpn, value);
+}
+
+// ============================================================================
+// Comparison
+// ============================================================================
+
+// What one board's layout looks like from the outside
+struct Board {
+  const char *name;
+  ChannelEntry *channels;
+  const bool *slotUsed;
+  bool (*expression)(int tileChannel, int note, int32_t *bend,
+                     uint32_t *level);
+};
+
+static bool sameRect(const Rect &a, const Rect &b) {
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Lit note tile n of channel c, clipped to slice. False if nothing shows.
+static bool drawnTile(const Board &b, int c, int n, const Rect &slice,
+                      Rect *out) {
+  const ChannelEntry &ch = b.channels[c];
+  if (!ch.seen || !ch.notes)
+    return false;
+  const NoteEntry &ne = ch.notes[n];
+  if (!ne.seen || !ne.active)
+    return false;
+  int x0 = ne.bounds.x > slice.x ? ne.bounds.x : slice.x;
+  int y0 = ne.bounds.y > slice.y ? ne.bounds.y : slice.y;
+  int x1 = ne.bounds.x + ne.bounds.w;
+  int y1 = ne.bounds.y + ne.bounds.h;
+  if (x1 > slice.x + slice.w)
+    x1 = slice.x + slice.w;
+  if (y1 > slice.y + slice.h)
+    y1 = slice.y + slice.h;
+  if (x1 <= x0 || y1 <= y0)
+    return false;
+  *out = Rect{x0, y0, x1 - x0, y1 - y0};
+  return true;
+}
+
+static bool isLit(const Board &b, int c, int n) {
+  const ChannelEntry &ch = b.channels[c];
+  return ch.seen && ch.notes && ch.notes[n].seen && ch.notes[n].active;
+}
+
+// Empty string if the follower shows what the master does, else the reason
+static const char *compare(const Board &m, const Board &f, int index) {
+  static char why[160];
+  Rect slice = {0, index * PANEL_HEIGHT * LAYOUT_ONE, WALL_WIDTH * LAYOUT_ONE,
+                PANEL_HEIGHT * LAYOUT_ONE};
+
+  int used = 0;
+  for (int s = 0; s < CHANNEL_SLOTS; s++) {
+    used += f.slotUsed[s];
+  }
+  int seen = 0;
+  for (int c = 0; c < MAX_CHANNELS; c++) {
+    seen += f.channels[c].seen;
+    if (m.channels[c].seen != f.channels[c].seen) {
+      snprintf(why, sizeof(why), "channel %d is %s", c + 1,
+               f.channels[c].seen ? "stale" : "missing");
+      return why;
+    }
+    for (int n = 0; n < MAX_NOTES; n++) {
+      if (isLit(m, c, n) != isLit(f, c, n)) {
+        snprintf(why, sizeof(why), "channel %d note %d is %s", c + 1, n,
+                 isLit(f, c, n) ? "lit" : "dark");
+        return why;
+      }
+      Rect mr, fr;
+      bool md = drawnTile(m, c, n, slice, &mr);
+      bool fd = drawnTile(f, c, n, slice, &fr);
+      if (md != fd || (md && !sameRect(mr, fr))) {
+        snprintf(why, sizeof(why), "channel %d note %d tile differs", c + 1,
+                 n);
+        return why;
+      }
+      // How renderLayout() would draw it: slid and dimmed, or plain
+      int32_t mb = 0, fb = 0;
+      uint32_t ml = 0, fl = 0;
+      bool me = md && m.expression(c, n, &mb, &ml);
+      bool fe = fd && f.expression(c, n, &fb, &fl);
+      if (me != fe || mb != fb || ml != fl) {
+        snprintf(why, sizeof(why), "channel %d note %d expression differs",
+                 c + 1, n);
+        return why;
+      }
+    }
+  }
+  if (used != seen) {
+    snprintf(why, sizeof(why), "%d note tables for %d channels", used, seen);
+    return why;
+  }
+  return "";
+}
+
+// ============================================================================
+// Follower Link Ends
+// ============================================================================
+
+struct Follower {
+  int index;
+  void (*apply)(const LinkPacket &pkt);
+  Board board;
+  LinkDecoder decoder;
+  int lastSeq; // Sequence number of the last PRESENT, -1 before the first
+};
+
+static Follower followers[FOLLOWERS] = {
+    {1,
+     f1::f1_linksync_apply,
+     {"follower 1", f1::channels, f1::slotUsed, f1::mpe_expression},
+     {},
+     -1},
+    {2,
+     f2::f2_linksync_apply,
+     {"follower 2", f2::channels, f2::slotUsed, f2::mpe_expression},
+     {},
+     -1},
+    {3,
+     f3::f3_linksync_apply,
+     {"follower 3", f3::channels, f3::slotUsed, f3::mpe_expression},
+     {},
+     -1},
+};
+
+static void receive(Follower &f, const uint8_t *buf, int len, int dropOneIn) {
+  for (int i = 0; i < len; i++) {
+    if (dropOneIn > 0 && rand() % dropOneIn == 0)
+      continue;
+    if (!linkproto_feed(&f.decoder, buf[i]))
+      continue;
+    if (f.decoder.pkt.type == LINK_MSG_PRESENT && f.decoder.pkt.len > 0)
+      f.lastSeq = f.decoder.pkt.payload[0];
+    f.apply(f.decoder.pkt);
+  }
+}
+
+// ============================================================================
+// MIDI Generator
+// ============================================================================
+
+struct HeldNote {
+  uint8_t port, status, note;
+};
+
+static HeldNote held[64];
+static int heldCount = 0;
+static MidiParser parsers[MIDI_PORTS];
+
+static void send(int port, uint8_t a, uint8_t b, uint8_t c) {
+  midiparser_processByte(&parsers[port], a, 0);
+  midiparser_processByte(&parsers[port], b, 0);
+  midiparser_processByte(&parsers[port], c, 0);
+}
+
+static void send2(int port, uint8_t a, uint8_t b) {
+  midiparser_processByte(&parsers[port], a, 0);
+  midiparser_processByte(&parsers[port], b, 0);
+}
+
+static void randomEvent() {
+  int r = rand() % 100;
+  int port = rand() % MIDI_PORTS;
+  if (r < 45 && heldCount < 64) {
+    HeldNote h = {(uint8_t)port, (uint8_t)(0x90 | rand() % 16),
+                  (uint8_t)(36 + rand() % 48)};
+    held[heldCount++] = h;
+    send(h.port, h.status, h.note, 100);
+  } else if (r < 85 && heldCount > 0) {
+    int i = rand() % heldCount;
+    HeldNote h = held[i];
+    held[i] = held[--heldCount];
+    send(h.port, (uint8_t)(0x80 | (h.status & 0x0F)), h.note, 0);
+  } else if (r < 91) {
+    send(port, (uint8_t)(0xE0 | rand() % 16), (uint8_t)(rand() % 128),
+         (uint8_t)(rand() % 128));
+  } else if (r < 96) {
+    send2(port, (uint8_t)(0xD0 | rand() % 16), (uint8_t)(rand() % 128));
+  } else if (r < 99) {
+    // MPE Configuration Message for a random zone; members fold away
+    uint8_t status = rand() % 2 ? 0xB0 : 0xBF;
+    send(port, status, 101, 0);
+    send(port, status, 100, 6);
+    send(port, status, 6, (uint8_t)(rand() % 8));
+  }
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static const int TX_BUFFER_SIZE = 2048; // As in link.cpp
+static const int REFRESH_ROUND = MAX_CHANNELS * LINK_REFRESH_FRAMES;
+
+static int lossWindows[2][2]; // Frames in which follower 2 loses bytes
+static int lateJoin;          // First frame follower 3 hears
+
+static bool losing(int frame) {
+  for (auto &w : lossWindows) {
+    if (frame >= w[0] && frame < w[1])
+      return true;
+  }
+  return false;
+}
+
+// Whether follower index has to match the master after this frame
+static bool mustMatch(int index, int frame) {
+  if (index == 2) {
+    for (auto &w : lossWindows) {
+      if (frame >= w[0] && frame < w[1] + 2 * REFRESH_ROUND)
+        return false;
+    }
+  } else if (index == 3) {
+    return frame >= lateJoin + REFRESH_ROUND;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 20000;
+  unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+  srand(seed);
+
+  lossWindows[0][0] = frames / 5;
+  lossWindows[0][1] = frames / 5 + 300;
+  lossWindows[1][0] = frames / 2;
+  lossWindows[1][1] = frames / 2 + 40;
+  lateJoin = frames / 3;
+
+  for (int i = 0; i < MIDI_PORTS; i++) {
+    midiparser_init(&parsers[i], i * 16, false);
+  }
+  master::layout_init();
+  master::mpe_init();
+  f1::layout_init();
+  f1::mpe_init();
+  f2::layout_init();
+  f2::mpe_init();
+  f3::layout_init();
+  f3::mpe_init();
+  for (Follower &f : followers) {
+    linkproto_initDecoder(&f.decoder);
+  }
+
+  Board m = {"master", master::channels, master::slotUsed,
+             master::mpe_expression};
+  static uint8_t buf[TX_BUFFER_SIZE];
+  int checks[FOLLOWERS] = {0};
+  int resets = 0;
+
+  for (int frame = 0; frame < frames; frame++) {
+    int events = rand() % 7;
+    for (int e = 0; e < events; e++) {
+      randomEvent();
+    }
+    if (rand() % 2000 == 0) {
+      // Reset button: every board starts over
+      master::layout_reset();
+      master::linksync_masterReset();
+      resets++;
+    }
+
+    uint8_t mode = (frame / 1000) & 1; // Stands in for main.cpp's VisMode
+    int len = master::linksync_masterFrame(buf, TX_BUFFER_SIZE,
+                                           global_brightness, mode, 256, 0);
+    bool backlog = master::linksync_masterBacklog();
+
+    for (Follower &f : followers) {
+      if (f.index == 3 && frame < lateJoin)
+        continue;
+      receive(f, buf, len, f.index == 2 && losing(frame) ? 30 : 0);
+
+      // A frame with changes left over is only complete on the next one
+      if (backlog || !mustMatch(f.index, frame))
+        continue;
+      const char *why = compare(m, f.board, f.index);
+      if (!*why && f.lastSeq != (frame & 0xFF))
+        why = "missed PRESENT";
+      else if (!*why && modes[f.index] != mode)
+        why = "visualization mode differs";
+      if (*why) {
+        fprintf(stderr, "frame %d: %s: %s\n", frame, f.board.name, why);
+        return 1;
+      }
+      checks[f.index - 1]++;
+    }
+  }
+
+  printf("%d frames, %d resets, %lu link errors on follower 2\n", frames,
+         resets, (unsigned long)followers[1].decoder.errors);
+  for (int i = 0; i < FOLLOWERS; i++) {
+    printf("%s: %d frames checked, %d PRESENT\n", followers[i].board.name,
+           checks[i], presents[i + 1]);
+  }
+  return 0;
+}
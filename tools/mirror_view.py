@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Show what the panel is showing, live, in a terminal.
+
+Usage: mirror_view.py /dev/ttyACM0
+
+Sends 'mirror on' and draws the frames that follow with 24-bit ANSI colors
+(two pixels per character cell); Ctrl-C sends 'mirror off'. The packet
+format is described in mirror.h. Console text between packets is skipped.
+Requires pyserial.
+"""
+
+import struct
+import sys
+import time
+
+import serial
+
+MAGIC = b"MR"
+HEADER = struct.Struct("<2sccBBH")
+KEYFRAME = b"K"
+DELTA = b"D"
+
+
+def apply_runs(pixels, payload):
+    """Decode one payload onto pixels in place; False if it doesn't fit."""
+    i = 0
+    pos = 0
+    while pos < len(payload):
+        op = payload[pos]
+        n = (op & 0x7F) + 1
+        if i + n > len(pixels):
+            return False
+        if op & 0x80:
+            if pos + 4 > len(payload):
+                return False
+            color = tuple(payload[pos + 1:pos + 4])
+            pixels[i:i + n] = [color] * n
+            pos += 4
+        else:
+            pos += 1
+        i += n
+    return i == len(pixels)
+
+
+class Mirror:
+    def __init__(self):
+        self.buf = bytearray()
+        self.pixels = None
+        self.size = None
+        self.seq = None
+        self.frames = 0
+        self.lost = 0
+
+    def feed(self, data):
+        """Consume serial bytes; returns True when a new frame is complete."""
+        self.buf += data
+        updated = False
+        while True:
+            start = self.buf.find(MAGIC)
+            if start < 0:
+                del self.buf[:-1]  # Keep a possible first magic byte
+                return updated
+            del self.buf[:start]
+            if len(self.buf) < HEADER.size:
+                return updated
+            _, kind, seq, w, h, length = HEADER.unpack_from(self.buf)
+            end = HEADER.size + length + 1
+            if kind not in (KEYFRAME, DELTA) or w == 0 or h == 0:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < end:
+                return updated
+            payload = bytes(self.buf[HEADER.size:end - 1])
+            if sum(payload) & 0xFF != self.buf[end - 1]:
+                del self.buf[:1]  # Text got in the way
+                continue
+            del self.buf[:end]
+            if self.accept(kind, seq[0], (w, h), payload):
+                updated = True
+
+    def accept(self, kind, seq, size, payload):
+        if kind == KEYFRAME:
+            pixels = [(0, 0, 0)] * (size[0] * size[1])
+        elif self.seq is not None and seq == (self.seq + 1) & 0xFF \
+                and size == self.size:
+            pixels = list(self.pixels)
+        else:
+            self.lost += 1  # Wait for the next keyframe
+            self.seq = None
+            return False
+        if not apply_runs(pixels, payload):
+            self.lost += 1
+            self.seq = None
+            return False
+        self.pixels, self.size, self.seq = pixels, size, seq
+        self.frames += 1
+        return True
+
+
+def draw(mirror, status):
+    w, h = mirror.size
+    px = mirror.pixels
+    out = ["\x1b[H"]
+    for y in range(0, h, 2):
+        for x in range(w):
+            top = px[y * w + x]
+            bottom = px[(y + 1) * w + x] if y + 1 < h else (0, 0, 0)
+            out.append("\x1b[38;2;%d;%d;%dm\x1b[48;2;%d;%d;%dm▀" %
+                       (top + bottom))
+        out.append("\x1b[0m\n")
+    out.append(status + "\x1b[K\n")
+    sys.stdout.write("".join(out))
+    sys.stdout.flush()
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+
+    mirror = Mirror()
+    with serial.Serial(sys.argv[1], timeout=0.05) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"mirror on\n")
+        sys.stdout.write("\x1b[2J")
+        received = 0
+        window_start = time.time()
+        window_frames = 0
+        fps = rate = 0.0
+        try:
+            while True:
+                data = ser.read(max(1, ser.in_waiting))
+                received += len(data)
+                if not mirror.feed(data):
+                    continue
+                window_frames += 1
+                now = time.time()
+                if now - window_start >= 1.0:
+                    fps = window_frames / (now - window_start)
+                    rate = received / (now - window_start) / 1024
+                    window_start, window_frames, received = now, 0, 0
+                draw(mirror, "%dx%d  %5.1f fps  %6.1f KB/s  frames %d  lost %d"
+                     % (mirror.size + (fps, rate, mirror.frames, mirror.lost)))
+        except KeyboardInterrupt:
+            pass
+        finally:
+            ser.write(b"mirror off\n")
+            sys.stdout.write("\x1b[0m\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Poll health counters from one or more units over USB serial.
+
+Usage: telemetry_poll.py [--interval SECONDS] /dev/ttyACM0 [/dev/ttyACM1 ...]
+
+Sends 'telemetry bin' to each port and prints one line per unit. The
+snapshot layout is TelemetrySnapshot in telemetry.h. Requires pyserial.
+"""
+
+import struct
+import sys
+import time
+
+import serial
+
+MAGIC = 0x4D4C4554
+VERSION = 1
+PORTS = 2
+
+HEADER = struct.Struct("<IHH8sI")
+PORT = struct.Struct("<8I")
+TAIL = struct.Struct("<11I")
+SIZE = HEADER.size + PORTS * PORT.size + TAIL.size
+
+PORT_FIELDS = ("rx_bytes", "overrun", "framing", "break", "ring_drops",
+               "resyncs", "messages", "bytes_per_sec")
+TAIL_FIELDS = ("frames", "frames_skipped", "frame_overruns", "render_us",
+               "render_max_us", "transmit_us", "events_per_frame",
+               "events_per_frame_max", "fps_x100", "thru_drops",
+               "task_overruns")
+
+
+def read_snapshot(ser):
+    ser.reset_input_buffer()
+    ser.write(b"telemetry bin\n")
+    while True:
+        line = ser.readline()
+        if not line:
+            raise IOError("no response")
+        if line.startswith(b"TELEMETRY "):
+            size = int(line.split()[1])
+            break
+    data = ser.read(size)
+    if size != SIZE or len(data) != SIZE:
+        raise IOError("unexpected snapshot size %d" % len(data))
+
+    magic, version, _, board, uptime = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        raise IOError("bad snapshot header")
+    snap = {"board": board.hex(), "uptime_ms": uptime, "ports": []}
+    off = HEADER.size
+    for _ in range(PORTS):
+        snap["ports"].append(dict(zip(PORT_FIELDS, PORT.unpack_from(data, off))))
+        off += PORT.size
+    snap.update(zip(TAIL_FIELDS, TAIL.unpack_from(data, off)))
+    return snap
+
+
+def errors(port):
+    return port["overrun"] + port["framing"] + port["break"] + port["ring_drops"]
+
+
+def main():
+    args = sys.argv[1:]
+    interval = None
+    if args[:1] == ["--interval"]:
+        interval = float(args[1])
+        args = args[2:]
+    if not args:
+        sys.exit(__doc__)
+
+    links = [serial.Serial(p, timeout=2) for p in args]
+    while True:
+        for name, ser in zip(args, links):
+            try:
+                s = read_snapshot(ser)
+            except IOError as e:
+                print("%-14s %s" % (name, e))
+                continue
+            p1, p2 = s["ports"]
+            print("%-14s %s up %6ds  %5.1f fps  render %4d/%4d us  "
+                  "skip %d  in %d/%d B/s  err %d/%d  resync %d/%d" % (
+                      name, s["board"], s["uptime_ms"] // 1000,
+                      s["fps_x100"] / 100.0, s["render_us"],
+                      s["render_max_us"], s["frames_skipped"],
+                      p1["bytes_per_sec"], p2["bytes_per_sec"],
+                      errors(p1), errors(p2), p1["resyncs"], p2["resyncs"]))
+        if interval is None:
+            break
+        time.sleep(interval)
+
+
+if __name__ == "__main__":
+    main()